@@ -9,6 +9,10 @@ import win32security
 import ntsecuritycon as con
 import winreg
 import zlib
+import struct
+import threading
+import time
+from contextlib import contextmanager
 
 from PySide6.QtWidgets import QApplication, QWidget, QSystemTrayIcon, QMenu
 from PySide6.QtGui import QIcon, QAction
@@ -29,6 +33,77 @@ import subprocess
 warnings.filterwarnings("ignore")
 
 
+# Id of the request being handled by this thread, see RequestIdFilter
+request_context = threading.local()
+
+
+class RequestIdFilter(logging.Filter):
+    """Tags log records with the id of the engine request being handled."""
+
+    def filter(self, record):
+        record.request_id = getattr(request_context, "request_id", None) or "-"
+        return True
+
+
+class ChromeTrace:
+    """Writes spans to a Chrome trace event file.
+
+    Same format and clock as the engine's TraceChromeFile (JSON array
+    format without the closing bracket, microseconds of the monotonic
+    clock), so the two files can be merged into one timeline with
+    tools/merge_traces.py. Does nothing without a file.
+    """
+
+    def __init__(self, path=None):
+        self.lock = threading.Lock()
+        self.file = None
+        if not path:
+            return
+        try:
+            self.file = open(path, "a", encoding="utf-8")
+        except OSError as e:
+            logging.error(f"Cannot open trace file {path}: {e}")
+            return
+        if self.file.tell() == 0:
+            self.file.write("[\n")
+        self._write(
+            {"name": "process_name", "ph": "M", "pid": os.getpid(), "args": {"name": "VoiceServer"}}
+        )
+
+    def _write(self, event):
+        with self.lock:
+            self.file.write(json.dumps(event) + ",\n")
+            self.file.flush()
+
+    @contextmanager
+    def span(self, name, cat="server"):
+        """Records the enclosed block, tagged with the current request id."""
+        if self.file is None:
+            yield
+            return
+        start = time.perf_counter_ns()
+        try:
+            yield
+        finally:
+            end = time.perf_counter_ns()
+            event = {
+                "name": name,
+                "cat": cat,
+                "ph": "X",
+                "ts": start / 1000,
+                "dur": (end - start) / 1000,
+                "pid": os.getpid(),
+                "tid": threading.get_native_id(),
+            }
+            request_id = getattr(request_context, "request_id", None)
+            if request_id:
+                event["args"] = {"request_id": request_id}
+            self._write(event)
+
+
+tracer = ChromeTrace()
+
+
 # Helper to setup logging
 def setup_logging():
     if getattr(sys, "frozen", False):
@@ -47,9 +122,11 @@ def setup_logging():
     logging.basicConfig(
         filename=log_file,
         filemode="a",
-        format="%(asctime)s — %(name)s — %(levelname)s — %(funcName)s:%(lineno)d — %(message)s",
+        format="%(asctime)s — %(name)s — %(levelname)s — [%(request_id)s] %(funcName)s:%(lineno)d — %(message)s",
         level=logging.DEBUG,
     )
+    for handler in logging.getLogger().handlers:
+        handler.addFilter(RequestIdFilter())
 
     return log_file
 
@@ -107,6 +184,13 @@ def load_config(config_path="settings.cfg"):
     return engines
 
 
+def load_trace_file(config_path="settings.cfg"):
+    """Chrome trace file from the [Trace] section, or None."""
+    config = configparser.ConfigParser()
+    config.read(config_path)
+    return config.get("Trace", "file", fallback=None) or None
+
+
 def init_engines(engines):
     """Initialize TTS clients and TTS classes for the engines specified in the configuration."""
     initialized_engines = {}
@@ -307,12 +391,17 @@ class PipeServerThread(QThread):
                         engine_name = request.get("engine")
                         voice_name = request.get("voice")
                         text = request.get("text")
+                        window = request.get("window")
+                        request_context.request_id = request.get("request_id")
                         if engine_name in self.engines:
                             tts_engine = self.engines[engine_name]
                             logging.info(
                                 f"Speaking text with {engine_name} and voice {voice_name}: {text[:50]}..."
                             )
-                            self.speak_text_streamed(pipe, tts_engine, text, voice_name)
+                            with tracer.span("server.speak"):
+                                self.speak_text_streamed(
+                                    pipe, tts_engine, text, voice_name, window
+                                )
                 logging.info("Processing complete. Ready for next connection.")
             except Exception as e:
                 logging.error(f"Pipe server error: {e}", exc_info=True)
@@ -320,6 +409,7 @@ class PipeServerThread(QThread):
                 if pipe:
                     win32file.CloseHandle(pipe)
                 logging.info("Pipe closed. Reopening for next connection.")
+                request_context.request_id = None
 
     def fetch_voices(self, engine_name, pipe):
         """Fetch voices for the selected engine and ensure the response is fully transmitted."""
@@ -375,17 +465,56 @@ class PipeServerThread(QThread):
         except Exception as e:
             logging.error(f"Error sending large data: {e}")
 
-    def speak_text_streamed(self, pipe, tts_engine, text, voice):
-        """Speaks the text using the TTS engine, streaming the PCM bytes back."""
+    def speak_text_streamed(self, pipe, tts_engine, text, voice, window=None):
+        """Speaks the text using the TTS engine, streaming the PCM bytes back.
+
+        If the client sent a flow control window, at most that many bytes are
+        outstanding at once; the next chunk is not pulled from the engine until
+        the client grants more credit. Without a window audio is sent as fast
+        as it is produced.
+        """
         # Set the voice on the engine (if required)
         if hasattr(tts_engine, "set_voice"):
-            tts_engine.set_voice(voice)
+            with tracer.span("server.set_voice"):
+                tts_engine.set_voice(voice)
 
-        # Use synth_to_bytestream to get the raw PCM audio bytes
-        for audio_chunk in tts_engine.synth_to_bytes(text):
-            win32file.WriteFile(
-                pipe, audio_chunk
-            )  # Send PCM 16-bit audio data to SAPI or the client
+        credit = window
+
+        # Use synth_to_bytestream to get the raw PCM audio bytes. Each pull
+        # is traced, a gap between pipe writes is the engine synthesizing.
+        chunks = iter(tts_engine.synth_to_bytes(text))
+        while True:
+            with tracer.span("server.synth_chunk", "tts"):
+                audio_chunk = next(chunks, None)
+            if audio_chunk is None:
+                break
+
+            if credit is None:
+                with tracer.span("server.write", "pipe"):
+                    win32file.WriteFile(
+                        pipe, audio_chunk
+                    )  # Send PCM 16-bit audio data to SAPI or the client
+                continue
+
+            chunk = memoryview(audio_chunk)
+            while chunk:
+                while credit == 0:
+                    with tracer.span("server.credit_wait", "pipe"):
+                        credit += self.read_credit(pipe)
+                n = min(credit, len(chunk))
+                with tracer.span("server.write", "pipe"):
+                    win32file.WriteFile(pipe, chunk[:n])
+                credit -= n
+                chunk = chunk[n:]
+
+    def read_credit(self, pipe):
+        """Block until the client grants more credit and return the byte count.
+
+        Raises if the client has gone away, which cancels the synthesis.
+        """
+        result, data = win32file.ReadFile(pipe, 4)
+        (credit,) = struct.unpack("<I", data)
+        return credit
 
     def register_sapi_engine(self, engine_dll):
         """Register the SAPI engine DLL for both 32-bit and 64-bit registry paths."""
@@ -565,6 +694,7 @@ class SystemTrayIcon(QSystemTrayIcon):
 # Main application entry point
 if __name__ == "__main__":
     logfile = setup_logging()
+    tracer = ChromeTrace(load_trace_file())
     # Load configuration from .env if necessary
     load_dotenv(dotenv_path="./.env")
     app = QApplication(sys.argv)
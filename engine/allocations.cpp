@@ -0,0 +1,136 @@
+#include "allocations.h"
+
+#if defined(PYSAPI_ALLOCATION_STATS)
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Trivial, so it needs no constructor call on a thread's first allocation
+thread_local allocations::Counters thread_;
+
+std::atomic<int64_t> live_ {0};
+std::atomic<uint64_t> count_ {0};
+
+// Keeps the block behind it aligned for any type operator new serves
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header {
+    size_t size;
+};
+
+void* allocate(size_t size) noexcept {
+    auto* header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+    if (header == nullptr) {
+        return nullptr;
+    }
+    header->size = size;
+
+    auto& counters = thread_;
+    counters.count++;
+    counters.bytes += size;
+    counters.live_bytes += size;
+    if (counters.live_bytes > counters.peak_bytes) {
+        counters.peak_bytes = counters.live_bytes;
+    }
+    live_.fetch_add(int64_t(size), std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    return header + 1;
+}
+
+void deallocate(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    auto* header = static_cast<Header*>(p) - 1;
+    thread_.live_bytes -= header->size;
+    live_.fetch_sub(int64_t(header->size), std::memory_order_relaxed);
+    std::free(header);
+}
+
+void* allocate_or_throw(size_t size) {
+    void* p = allocate(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+} // namespace
+
+// Over-aligned forms are left to the runtime; they pair with their own
+// operator delete and are never passed to these
+void* operator new(size_t size) {
+    return allocate_or_throw(size);
+}
+
+void* operator new[](size_t size) {
+    return allocate_or_throw(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    deallocate(p);
+}
+
+void operator delete[](void* p) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    deallocate(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    deallocate(p);
+}
+
+allocations::Counters allocations::thread_counters() noexcept {
+    return thread_;
+}
+
+void allocations::reset_peak() noexcept {
+    thread_.peak_bytes = thread_.live_bytes;
+}
+
+int64_t allocations::live_bytes() noexcept {
+    return live_.load(std::memory_order_relaxed);
+}
+
+uint64_t allocations::count() noexcept {
+    return count_.load(std::memory_order_relaxed);
+}
+
+#else
+
+allocations::Counters allocations::thread_counters() noexcept {
+    return {};
+}
+
+void allocations::reset_peak() noexcept {}
+
+int64_t allocations::live_bytes() noexcept {
+    return 0;
+}
+
+uint64_t allocations::count() noexcept {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation accounting. Built with PYSAPI_ALLOCATION_STATS defined
+// (the ALLOCATION_STATS CMake option), the module's global operator new and
+// delete are replaced by versions that count every allocation, per thread
+// and for the whole process. Each block then carries a 16-byte header with
+// its size, so this is a diagnostic build, not one to ship.
+//
+// Memory allocated by Python, by the CRT's malloc directly or by other
+// modules is not seen; for Python use sys.getallocatedblocks().
+namespace allocations {
+
+#if defined(PYSAPI_ALLOCATION_STATS)
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+// Allocations made by one thread. live_bytes goes down when the thread
+// frees a block, whichever thread allocated it, so it can be negative.
+struct Counters {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    int64_t live_bytes = 0;
+    // Highest live_bytes since the last reset_peak()
+    int64_t peak_bytes = 0;
+};
+
+// Counters of the calling thread. All zero when not enabled.
+Counters thread_counters() noexcept;
+
+// Restarts the calling thread's peak from its current live bytes
+void reset_peak() noexcept;
+
+// Bytes allocated and not yet freed by the whole process
+int64_t live_bytes() noexcept;
+
+// Allocations made by the whole process
+uint64_t count() noexcept;
+
+// Allocations of the calling thread from construction to the last call to
+// stop(): how many, how many bytes, and the most held at once on top of
+// what the thread held at the start
+class Scope {
+public:
+    Scope() noexcept {
+        if constexpr (enabled) {
+            start_ = thread_counters();
+            reset_peak();
+        }
+    }
+
+    void stop() noexcept {
+        if constexpr (enabled) {
+            Counters now = thread_counters();
+            count_ = now.count - start_.count;
+            bytes_ = now.bytes - start_.bytes;
+            peak_bytes_ = now.peak_bytes > start_.live_bytes ? uint64_t(now.peak_bytes - start_.live_bytes) : 0;
+        }
+    }
+
+    uint64_t count() const noexcept { return count_; }
+    uint64_t bytes() const noexcept { return bytes_; }
+    uint64_t peak_bytes() const noexcept { return peak_bytes_; }
+
+private:
+    Counters start_;
+    uint64_t count_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t peak_bytes_ = 0;
+};
+
+} // namespace allocations
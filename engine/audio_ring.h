@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+// Lock-free single-producer/single-consumer ring of preallocated PCM blocks.
+//
+// The producer (pipe reader thread) fills the block returned by acquire() and
+// publishes it with commit(). The consumer (the thread calling
+// ISpTTSEngineSite::Write) takes the oldest block with front() and hands it
+// back with release(). Blocking uses std::atomic wait/notify, which maps to
+// futex on Linux and WaitOnAddress on Windows.
+//
+// close() marks the end of the stream: the consumer drains what is left and
+// then gets an empty span. cancel() is the consumer giving up: the producer's
+// next acquire() returns an empty span.
+class AudioRing {
+public:
+    AudioRing(size_t block_count, size_t block_size)
+        : block_count_(block_count),
+          block_size_(block_size),
+          blocks_(std::make_unique<Block[]>(block_count)) {
+        // Slots are indexed by a wrapping 31-bit counter
+        assert(block_count > 0 && (block_count & (block_count - 1)) == 0);
+        for (size_t i = 0; i < block_count_; i++) {
+            blocks_[i].data = std::make_unique<char[]>(block_size_);
+        }
+    }
+
+    AudioRing(const AudioRing&) = delete;
+    AudioRing& operator=(const AudioRing&) = delete;
+
+    // Must only be called while neither side is running
+    void reset() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        released_bytes_.store(0, std::memory_order_relaxed);
+        cached_head_ = 0;
+        cached_tail_ = 0;
+    }
+
+    size_t block_size() const {
+        return block_size_;
+    }
+
+    size_t capacity() const {
+        return block_count_ * block_size_;
+    }
+
+    // Total bytes the consumer has handed back since reset(). Safe to read
+    // from the producer, e.g. to grant flow control credit.
+    uint64_t released_bytes() const {
+        return released_bytes_.load(std::memory_order_acquire);
+    }
+
+    // Producer
+
+    std::span<char> acquire() {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        while (distance(cached_head_, tail) == block_count_) {
+            uint32_t head = head_.load(std::memory_order_acquire);
+            if (head & kFlag) {
+                return {};
+            }
+            if (head == cached_head_) {
+                head_.wait(head, std::memory_order_acquire);
+                continue;
+            }
+            cached_head_ = head;
+        }
+        if (head_.load(std::memory_order_relaxed) & kFlag) {
+            return {};
+        }
+        return {blocks_[slot(tail)].data.get(), block_size_};
+    }
+
+    void commit(size_t bytes) {
+        assert(bytes <= block_size_);
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        blocks_[slot(tail)].size = bytes;
+        tail_.store(next(tail), std::memory_order_release);
+        tail_.notify_one();
+    }
+
+    void close() {
+        tail_.fetch_or(kFlag, std::memory_order_release);
+        tail_.notify_one();
+    }
+
+    // Consumer
+
+    std::span<const char> front() {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        while ((cached_tail_ & ~kFlag) == head) {
+            if (cached_tail_ & kFlag) {
+                return {};
+            }
+            uint32_t tail = tail_.load(std::memory_order_acquire);
+            if (tail == cached_tail_) {
+                tail_.wait(tail, std::memory_order_acquire);
+                continue;
+            }
+            cached_tail_ = tail;
+        }
+        const Block& block = blocks_[slot(head)];
+        return {block.data.get(), block.size};
+    }
+
+    void release() {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        released_bytes_.fetch_add(blocks_[slot(head)].size, std::memory_order_release);
+        head_.store(next(head), std::memory_order_release);
+        head_.notify_one();
+    }
+
+    void cancel() {
+        head_.fetch_or(kFlag, std::memory_order_release);
+        head_.notify_one();
+    }
+
+private:
+    // The top bit of each index is the closed/cancelled flag, the rest is a
+    // free-running counter
+    static constexpr uint32_t kFlag = 0x80000000u;
+    static constexpr size_t kCacheLine = 64;
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+
+    static uint32_t next(uint32_t index) {
+        return (index + 1) & ~kFlag;
+    }
+
+    static size_t distance(uint32_t head, uint32_t tail) {
+        return ((tail & ~kFlag) - (head & ~kFlag)) & ~kFlag;
+    }
+
+    size_t slot(uint32_t index) const {
+        return (index & ~kFlag) & (block_count_ - 1);
+    }
+
+    const size_t block_count_;
+    const size_t block_size_;
+    const std::unique_ptr<Block[]> blocks_;
+
+    // Consumer-owned read index and its view of the producer's index
+    alignas(kCacheLine) std::atomic<uint32_t> head_ {0};
+    uint32_t cached_tail_ = 0;
+    std::atomic<uint64_t> released_bytes_ {0};
+
+    // Producer-owned write index and its view of the consumer's index
+    alignas(kCacheLine) std::atomic<uint32_t> tail_ {0};
+    uint32_t cached_head_ = 0;
+};
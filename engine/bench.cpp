@@ -0,0 +1,677 @@
+// Microbenchmarks of the per-fragment hot path: text encoding, the pipe
+// request, the audio ring, tracing, and the pycpp calls made for every
+// Python voice fragment. Helpers that replaced a simpler approach are timed
+// next to it. Results go to stdout as a table, or with --json as a file that
+// tools/compare_bench.py compares against the results of another commit.
+//
+// Each benchmark is calibrated to run for about --min-time seconds and then
+// repeated; the median and the fastest repetition are reported. The fastest
+// is the steadiest on a busy machine and is what comparisons use.
+
+#include "audio_ring.h"
+#include "pipe_client.h"
+#include "pycpp.h"
+#include "slog.h"
+#include "trace.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace {
+
+struct Settings {
+    std::string filter;
+    double min_time = 0.2;
+    unsigned repetitions = 5;
+    bool json = false;
+    bool list = false;
+};
+
+const char* usage = R"(Usage: bench [options]
+  --filter TEXT         only run benchmarks whose name contains TEXT
+  --min-time S          seconds per repetition (0.2)
+  --repetitions N       repetitions of each benchmark (5)
+  --json                print the results as JSON
+  --list                list the benchmarks and exit
+)";
+
+// Results are folded into this so the compiler cannot drop the work
+volatile uintptr_t sink;
+
+template <typename T>
+void keep(const T& value) {
+    if constexpr (std::is_pointer_v<T>) {
+        sink = sink + reinterpret_cast<uintptr_t>(value);
+    } else {
+        sink = sink + static_cast<uintptr_t>(value);
+    }
+}
+
+// Runs `iterations` operations
+using Body = std::function<void(uint64_t iterations)>;
+
+struct Benchmark {
+    std::string name;
+    // Payload per operation, for a throughput figure; 0 if not meaningful
+    uint64_t bytes;
+    Body body;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double median_ns;
+    double min_ns;
+    double max_ns;
+    uint64_t bytes;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double time_run(const Body& body, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    return seconds_since(start);
+}
+
+Result measure(const Benchmark& benchmark, const Settings& settings) {
+    // Grow the count until a run is long enough to time, then scale it to
+    // the target; this also warms up caches and the allocator
+    uint64_t iterations = 1;
+    double elapsed;
+    while ((elapsed = time_run(benchmark.body, iterations)) < settings.min_time / 10 && iterations < (1ull << 40)) {
+        iterations *= 2;
+    }
+    iterations = std::max<uint64_t>(1, static_cast<uint64_t>(iterations * settings.min_time / std::max(elapsed, 1e-9)));
+
+    std::vector<double> ns;
+    for (unsigned i = 0; i < settings.repetitions; i++) {
+        ns.push_back(time_run(benchmark.body, iterations) * 1e9 / iterations);
+    }
+    std::sort(ns.begin(), ns.end());
+    return {benchmark.name, iterations, ns[ns.size() / 2], ns.front(), ns.back(), benchmark.bytes};
+}
+
+// UTF-16 text of `length` code units made of `pattern` repeated
+std::u16string repeat(std::u16string_view pattern, size_t length) {
+    std::u16string text;
+    while (text.size() < length) {
+        text += pattern;
+    }
+    text.resize(length);
+    return text;
+}
+
+void add_utf8_benchmarks(std::vector<Benchmark>& benchmarks) {
+    struct Text {
+        const char* name;
+        std::u16string text;
+    };
+    // Surrogate pairs are kept whole: 256 is even and so are the patterns
+    static const Text texts[] = {
+        {"ascii_64", repeat(u"The quick brown fox jumps over the lazy dog. ", 64)},
+        {"ascii_4096", repeat(u"The quick brown fox jumps over the lazy dog. ", 4096)},
+        {"latin_256", repeat(u"Ça a été très facile, déjà vu. ", 256)},
+        {"cjk_256", repeat(u"今日は良い天気ですね。", 256)},
+        {"emoji_256", repeat(u"\U0001F600\U0001F44D", 256)},
+    };
+
+    for (const auto& text : texts) {
+        benchmarks.push_back({fmt::format("utf8_encode/{}", text.name), text.text.size() * 2, [&text](uint64_t n) {
+            std::string out;
+            for (uint64_t i = 0; i < n; i++) {
+                utf8_encode(std::u16string_view(text.text), out);
+                keep(out.size());
+            }
+        }});
+
+#if defined(_WIN32)
+        // What Engine::Speak did before utf8_encode: copy the fragment into
+        // a std::wstring, then size and convert it with two
+        // WideCharToMultiByte passes into a fresh std::string
+        benchmarks.push_back({fmt::format("utf8_wctmb/{}", text.name), text.text.size() * 2, [&text](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::wstring wide(text.text.begin(), text.text.end());
+                int size = WideCharToMultiByte(CP_UTF8, 0, &wide[0], (int)wide.size(), NULL, 0, NULL, NULL);
+                std::string out(size, 0);
+                WideCharToMultiByte(CP_UTF8, 0, &wide[0], (int)wide.size(), &out[0], size, NULL, NULL);
+                keep(out.size());
+            }
+        }});
+#endif
+    }
+}
+
+void add_pipe_benchmarks(std::vector<Benchmark>& benchmarks) {
+    benchmarks.push_back({"pipe/format_request", 0, [](uint64_t n) {
+        std::string text = "Please call Stella. Ask her to bring these things with her from the store.";
+        std::string out;
+        for (uint64_t i = 0; i < n; i++) {
+            format_speak_request({text, "Microsoft", i}, 256 * 1024, out);
+            keep(out.size());
+        }
+    }});
+}
+
+// The same block queue as AudioRing behind a mutex and two condition
+// variables, for comparison: what the ring would cost done the usual way
+class MutexRing {
+public:
+    MutexRing(size_t block_count, size_t block_size)
+        : blocks_(block_count, std::vector<char>(block_size)), sizes_(block_count) {}
+
+    std::span<char> acquire() {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [&] { return count_ < blocks_.size(); });
+        return blocks_[(head_ + count_) % blocks_.size()];
+    }
+
+    void commit(size_t bytes) {
+        {
+            std::lock_guard lock(mutex_);
+            sizes_[(head_ + count_) % blocks_.size()] = bytes;
+            count_++;
+        }
+        not_empty_.notify_one();
+    }
+
+    void close() {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+        }
+        not_empty_.notify_one();
+    }
+
+    std::span<const char> front() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [&] { return count_ > 0 || closed_; });
+        if (count_ == 0) {
+            return {};
+        }
+        return {blocks_[head_].data(), sizes_[head_]};
+    }
+
+    void release() {
+        {
+            std::lock_guard lock(mutex_);
+            head_ = (head_ + 1) % blocks_.size();
+            count_--;
+        }
+        not_full_.notify_one();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::vector<std::vector<char>> blocks_;
+    std::vector<size_t> sizes_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+    bool closed_ = false;
+};
+
+// Producer and consumer on two threads, as the pipe reader and the thread
+// writing to SAPI are
+template <typename Ring>
+void handoff(uint64_t n, size_t block_size) {
+    Ring ring(8, block_size);
+    std::thread producer([&] {
+        std::vector<char> chunk(block_size, 1);
+        for (uint64_t i = 0; i < n; i++) {
+            auto block = ring.acquire();
+            std::memcpy(block.data(), chunk.data(), block.size());
+            ring.commit(block.size());
+        }
+        ring.close();
+    });
+    for (auto block = ring.front(); !block.empty(); block = ring.front()) {
+        keep(block[0]);
+        ring.release();
+    }
+    producer.join();
+}
+
+void add_ring_benchmarks(std::vector<Benchmark>& benchmarks) {
+    constexpr size_t block_size = 4096;
+
+    // One block in and out on the same thread: the bookkeeping and the copy
+    benchmarks.push_back({"ring/block_4096", block_size, [](uint64_t n) {
+        AudioRing ring(8, block_size);
+        std::vector<char> chunk(block_size, 1);
+        for (uint64_t i = 0; i < n; i++) {
+            auto block = ring.acquire();
+            std::memcpy(block.data(), chunk.data(), block.size());
+            ring.commit(block.size());
+            keep(ring.front().size());
+            ring.release();
+        }
+    }});
+
+    benchmarks.push_back({"ring/handoff_4096", block_size, [](uint64_t n) {
+        handoff<AudioRing>(n, block_size);
+    }});
+
+    benchmarks.push_back({"ring/mutex_handoff_4096", block_size, [](uint64_t n) {
+        handoff<MutexRing>(n, block_size);
+    }});
+}
+
+// A per-chunk message filtered out at runtime, recorded, sampled, and
+// formatted on the calling thread as slog does
+void add_trace_benchmarks(std::vector<Benchmark>& benchmarks) {
+    static const std::string text = "Please call Stella.";
+    constexpr auto level = trace::Level::Warning;
+    constexpr auto category = trace::Category::General;
+    // Recorded events are flushed every so often so the ring never drops
+    // any; the flush, where they are formatted, is part of the time
+    constexpr uint64_t flush_every = 1024;
+
+    auto with_filter = [](bool enabled, auto&& body) {
+        trace::set_filter(level, enabled ? 1 << unsigned(category) : 0);
+        body();
+        trace::flush();
+        trace::set_filter(level, 0);
+    };
+
+    benchmarks.push_back({"trace/filtered", 0, [=](uint64_t n) {
+        with_filter(false, [&] {
+            for (uint64_t i = 0; i < n; i++) {
+                TRACE(level, category, "chunk={} bytes, wait={}us, text={}", i, int64_t(i) - 1, text);
+            }
+        });
+    }});
+
+    benchmarks.push_back({"trace/enabled", 0, [=](uint64_t n) {
+        with_filter(true, [&] {
+            for (uint64_t i = 0; i < n; i++) {
+                TRACE(level, category, "chunk={} bytes, wait={}us, text={}", i, int64_t(i) - 1, text);
+                if (i % flush_every == flush_every - 1) {
+                    trace::flush();
+                }
+            }
+        });
+    }});
+
+    benchmarks.push_back({"trace/sampled_16", 0, [=](uint64_t n) {
+        with_filter(true, [&] {
+            for (uint64_t i = 0; i < n; i++) {
+                TRACE_SAMPLED(16, level, category, "chunk={} bytes, wait={}us, text={}", i, int64_t(i) - 1, text);
+                if (i % (16 * flush_every) == 16 * flush_every - 1) {
+                    trace::flush();
+                }
+            }
+        });
+    }});
+
+    benchmarks.push_back({"trace/slog_filtered", 0, [=](uint64_t n) {
+        with_filter(false, [&] {
+            for (uint64_t i = 0; i < n; i++) {
+                slog("chunk={} bytes, wait={}us, text={}", i, int64_t(i) - 1, text);
+            }
+        });
+    }});
+
+    benchmarks.push_back({"trace/format_eager", 0, [](uint64_t n) {
+        std::string out;
+        for (uint64_t i = 0; i < n; i++) {
+            out.clear();
+            fmt::format_to(std::back_inserter(out), "chunk={} bytes, wait={}us, text={}", i, int64_t(i) - 1, text);
+            keep(out.size());
+        }
+    }});
+}
+
+// Runs `source` as a module of its own and returns its global `name`. Call
+// with the GIL held.
+pycpp::Obj python_global(const char* source, const char* name) {
+    pycpp::Obj globals {PyDict_New()};
+    pycpp::Obj result {PyRun_String(source, Py_file_input, globals, globals)};
+    return pycpp::Obj(pycpp::borrowed_ref, PyDict_GetItemString(globals, name));
+}
+
+void add_python_benchmarks(std::vector<Benchmark>& benchmarks) {
+    static const std::string text_utf8 = "Please call Stella. Ask her to bring these things with her from the store.";
+    static const std::wstring text_wide(text_utf8.begin(), text_utf8.end());
+    static const std::vector<char> audio(4096, 1);
+
+    benchmarks.push_back({"pycpp/convert_utf8", 0, [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::Obj text {pycpp::convert(text_utf8)};
+            keep(text.ptr());
+        }
+    }});
+
+    benchmarks.push_back({"pycpp/convert_wide", 0, [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::Obj text {pycpp::convert(text_wide)};
+            keep(text.ptr());
+        }
+    }});
+
+    benchmarks.push_back({"pycpp/bytes_4096", audio.size(), [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::Obj chunk {pycpp::bytes(audio)};
+            keep(chunk.ptr());
+        }
+    }});
+
+    // Creation and destruction of an owned reference
+    benchmarks.push_back({"pycpp/obj_new", 0, [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::Obj number {PyLong_FromUnsignedLongLong(i | (1ull << 40))};
+            keep(number.ptr());
+        }
+    }});
+
+    // The same with the error state queried on success too, as every Obj
+    // constructor did before check()
+    benchmarks.push_back({"pycpp/obj_new_throw_on_error", 0, [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        for (uint64_t i = 0; i < n; i++) {
+            PyObject* o = PyLong_FromUnsignedLongLong(i | (1ull << 40));
+            pycpp::throw_on_error();
+            pycpp::Obj number = pycpp::Obj::steal(o);
+            keep(number.ptr());
+        }
+    }});
+
+    // And unchecked, for results known to be valid
+    benchmarks.push_back({"pycpp/obj_new_steal", 0, [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::Obj number = pycpp::Obj::steal(PyLong_FromUnsignedLongLong(i | (1ull << 40)));
+            keep(number.ptr());
+        }
+    }});
+
+    // Stepping an iterator with iter_next(), which only looks at the error
+    // state at the end, and with the error state queried every item
+    auto iterate = [](uint64_t n, auto&& next) {
+        constexpr Py_ssize_t items = 256;
+        pycpp::ScopedGIL lock;
+        pycpp::Obj list {PyList_New(items)};
+        for (Py_ssize_t i = 0; i < items; i++) {
+            PyList_SET_ITEM(list.ptr(), i, PyLong_FromSsize_t(i));
+        }
+        pycpp::Obj iterator {PyObject_GetIter(list)};
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::Obj item = next(iterator.ptr());
+            if (!item) {
+                iterator = PyObject_GetIter(list);
+                continue;
+            }
+            keep(item.ptr());
+        }
+    };
+
+    benchmarks.push_back({"pycpp/iter_next", 0, [=](uint64_t n) {
+        iterate(n, [](PyObject* iterator) { return pycpp::iter_next(iterator); });
+    }});
+
+    benchmarks.push_back({"pycpp/iter_next_throw_on_error", 0, [=](uint64_t n) {
+        iterate(n, [](PyObject* iterator) {
+            PyObject* item = PyIter_Next(iterator);
+            pycpp::throw_on_error();
+            return item ? pycpp::Obj::steal(item) : pycpp::Obj();
+        });
+    }});
+
+    // voice.speak(text) with the result iterated, as for every fragment:
+    // through call_method() and an interned name, and through
+    // PyObject_CallMethod, which builds the name, a bound method and an
+    // argument tuple per call
+    auto speak = [](uint64_t n, auto&& call) {
+        pycpp::Obj voice;
+        pycpp::Obj text;
+        {
+            pycpp::ScopedGIL lock;
+            pycpp::Obj voice_class = python_global("class Voice:\n"
+                                                   "    chunk = bytes(4096)\n"
+                                                   "    def speak(self, text):\n"
+                                                   "        yield self.chunk\n"
+                                                   "        yield self.chunk\n",
+                                                   "Voice");
+            voice = pycpp::call(voice_class);
+            text = pycpp::convert(text_utf8);
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::ScopedGIL lock;
+            pycpp::Obj chunks = call(voice.ptr(), text.ptr());
+            pycpp::Obj iterator {PyObject_GetIter(chunks)};
+            while (pycpp::Obj chunk = pycpp::iter_next(iterator)) {
+                keep(chunk.ptr());
+            }
+        }
+        pycpp::ScopedGIL lock;
+        voice.reset();
+        text.reset();
+    };
+
+    benchmarks.push_back({"pycpp/speak_call_method", 0, [=](uint64_t n) {
+        speak(n, [](PyObject* voice, PyObject* text) {
+            static pycpp::Name speak_name {"speak"};
+            return pycpp::call_method(voice, speak_name, text);
+        });
+    }});
+
+    benchmarks.push_back({"pycpp/speak_PyObject_CallMethod", 0, [=](uint64_t n) {
+        speak(n, [](PyObject* voice, PyObject* text) {
+            return pycpp::Obj(PyObject_CallMethod(voice, "speak", "O", text));
+        });
+    }});
+
+    // Copies pay a reference each, moves nothing
+    benchmarks.push_back({"pycpp/obj_copy", 0, [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        pycpp::Obj list {PyList_New(0)};
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::Obj copy = list;
+            keep(copy.ptr());
+        }
+    }});
+
+    benchmarks.push_back({"pycpp/obj_move", 0, [](uint64_t n) {
+        pycpp::ScopedGIL lock;
+        pycpp::Obj a {PyList_New(0)};
+        pycpp::Obj b;
+        for (uint64_t i = 0; i < n; i++) {
+            b = std::move(a);
+            a = std::move(b);
+            keep(a.ptr());
+        }
+    }});
+
+    // Uncontended, from a thread that does not hold it
+    benchmarks.push_back({"pycpp/scoped_gil", 0, [](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            pycpp::ScopedGIL lock;
+            keep(i);
+        }
+    }});
+
+    // Chunks of a voice's generator as speak_from_voice() pulls them:
+    // batched PyIter_Next and a pinned buffer per chunk. Per chunk.
+    benchmarks.push_back({"pycpp/iter_chunks_4096", audio.size(), [](uint64_t n) {
+        constexpr uint64_t chunks_per_utterance = 64;
+        pycpp::Obj chunks;
+        {
+            pycpp::ScopedGIL lock;
+            pycpp::Obj chunk {pycpp::bytes(audio)};
+            chunks = PyList_New(chunks_per_utterance);
+            for (Py_ssize_t i = 0; i < Py_ssize_t(chunks_per_utterance); i++) {
+                PyList_SET_ITEM(chunks.ptr(), i, pycpp::incref(chunk));
+            }
+        }
+        for (uint64_t done = 0; done < n; done += chunks_per_utterance) {
+            pycpp::Obj iterator;
+            {
+                pycpp::ScopedGIL lock;
+                iterator = PyObject_GetIter(chunks);
+            }
+            pycpp::Iter range {std::move(iterator)};
+            for (const auto& chunk : range) {
+                keep(chunk.data.size());
+            }
+        }
+        pycpp::ScopedGIL lock;
+        chunks.reset();
+    }});
+
+    // A generator voice yielding thousands of tiny chunks, where the
+    // per-chunk cost of resuming the generator, batching and pinning is
+    // all there is. Per chunk.
+    benchmarks.push_back({"pycpp/iter_tiny_chunks", 16, [](uint64_t n) {
+        constexpr uint64_t chunks_per_utterance = 4096;
+        pycpp::Obj generate;
+        pycpp::Obj count;
+        {
+            pycpp::ScopedGIL lock;
+            generate = python_global("def generate(count):\n"
+                                     "    chunk = bytes(16)\n"
+                                     "    for _ in range(count):\n"
+                                     "        yield chunk\n",
+                                     "generate");
+            count = PyLong_FromUnsignedLongLong(chunks_per_utterance);
+        }
+        for (uint64_t done = 0; done < n; done += chunks_per_utterance) {
+            pycpp::Obj generator;
+            {
+                pycpp::ScopedGIL lock;
+                generator = pycpp::call(generate, count);
+            }
+            pycpp::Iter range {std::move(generator)};
+            for (const auto& chunk : range) {
+                keep(chunk.data.size());
+            }
+        }
+        pycpp::ScopedGIL lock;
+        generate.reset();
+        count.reset();
+    }});
+}
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--filter" && has_value) {
+            settings.filter = argv[++i];
+        } else if (arg == "--min-time" && has_value) {
+            settings.min_time = std::stod(argv[++i]);
+        } else if (arg == "--repetitions" && has_value) {
+            settings.repetitions = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--json") {
+            settings.json = true;
+        } else if (arg == "--list") {
+            settings.list = true;
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+    if (settings.min_time <= 0 || settings.repetitions == 0) {
+        throw std::invalid_argument("--min-time and --repetitions must be positive");
+    }
+    return settings;
+}
+
+void print_result(const Result& result, bool json, bool first) {
+    double bytes_per_sec = result.bytes ? result.bytes * 1e9 / result.min_ns : 0;
+    if (json) {
+        fmt::print(R"({}  {{"name":"{}","iterations":{},"median_ns":{:.3f},"min_ns":{:.3f},"max_ns":{:.3f},)"
+                   R"("bytes_per_sec":{:.0f}}})",
+                   first ? "" : ",\n", result.name, result.iterations, result.median_ns, result.min_ns,
+                   result.max_ns, bytes_per_sec);
+        return;
+    }
+    fmt::print("{:<32} {:>12} {:>12.1f} {:>12.1f}", result.name, result.iterations, result.median_ns, result.min_ns);
+    if (bytes_per_sec > 0) {
+        fmt::print(" {:>10.1f}", bytes_per_sec / (1 << 20));
+    }
+    fmt::print("\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    std::vector<Benchmark> benchmarks;
+    add_utf8_benchmarks(benchmarks);
+    add_pipe_benchmarks(benchmarks);
+    add_ring_benchmarks(benchmarks);
+    add_trace_benchmarks(benchmarks);
+    add_python_benchmarks(benchmarks);
+
+    if (settings.list) {
+        for (const auto& benchmark : benchmarks) {
+            fmt::print("{}\n", benchmark.name);
+        }
+        return 0;
+    }
+
+    // Started as the engine starts it; the main thread ends up without the GIL
+    pycpp::PythonVM vm;
+
+    if (settings.json) {
+        fmt::print(R"({{"min_time":{},"repetitions":{},"benchmarks":[)"
+                   "\n",
+                   settings.min_time, settings.repetitions);
+    } else {
+        fmt::print("{:<32} {:>12} {:>12} {:>12} {:>10}\n", "benchmark", "iterations", "median ns", "min ns", "MiB/s");
+    }
+
+    bool first = true;
+    for (const auto& benchmark : benchmarks) {
+        if (benchmark.name.find(settings.filter) == std::string::npos) {
+            continue;
+        }
+        print_result(measure(benchmark, settings), settings.json, first);
+        first = false;
+        std::fflush(stdout);
+    }
+
+    if (settings.json) {
+        fmt::print("\n]}}\n");
+    }
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include "engine.h"
 #include "resource.h"
 
+#include <thread>
+
 CComModule _Module;
 
 BEGIN_OBJECT_MAP(ObjectMap)
@@ -15,6 +17,21 @@ extern "C" BOOL WINAPI DllMain(HINSTANCE hInstance, DWORD dwReason, LPVOID /*lpR
     if (dwReason == DLL_PROCESS_ATTACH)
     {
         _Module.Init(ObjectMap, (HINSTANCE)hInstance, &LIBID_PySAPITTSEngine);
+
+        // The trace flusher, the asyncio loop and the interpreter itself run
+        // code from this DLL until the process exits, so it must never be
+        // unloaded. Pinned here, before any of them can start.
+        HMODULE module;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+                           reinterpret_cast<LPCWSTR>(&DllMain), &module);
+
+        // Nothing may wait on the loader lock here, so reading the settings
+        // is left to a thread that starts running once DllMain has returned
+        std::thread([]
+        {
+            StartTracing();
+            StartWarmUp();
+        }).detach();
     }
     else if (dwReason == DLL_PROCESS_DETACH)
         _Module.Term();
@@ -1,7411 +1,213 @@
 #include "engine.h"
+#include "live_stats.h"
+#include "metrics.h"
 #include "pycpp.h"
 #include "slog.h"
+#include "trace.h"
+#include "native_voice.h"
+#include "pipe_client.h"
+#include "utf8.h"
+#include "voice_registry.h"
 
 #include <cassert>
+#include <chrono>
+#include <filesystem>
 #include <string_view>
 #include <fmt/format.h>
 #include <fmt/xchar.h>
 #include <iostream>
+#include <mutex>
 #include <sstream>
-#include <json/json.h>
-        
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
-
-namespace
-{
-
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
-    {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
-    }
-
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
-    {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
-        {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
-        }
-
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
-
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
+#include <span>
+#include <thread>
 
 namespace
 {
+    // Process-wide settings, as opposed to the per-voice token values
+    const wchar_t *settings_key = LR"(SOFTWARE\PySAPITTSEngine)";
 
-    std::string utf8_encode(const std::wstring &wstr)
-    {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
-    }
-
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
-    return S_OK;
-}
-
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
-{
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
-    {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
-
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
-
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
-
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
-
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
-
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
-
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
-
-        CloseHandle(pipe);
-        return true;
-    }
-
-    CloseHandle(pipe);
-    return false;
-}
-
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
-{
-    slog("Engine::SetObjectToken");
-
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
-
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
+    std::vector<std::wstring> SplitList(std::wstring_view list)
     {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
+        std::vector<std::wstring> items;
+        for (size_t offset = 0; offset <= list.size();)
         {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
+            auto pos = list.find(L';', offset);
+            if (pos == std::wstring_view::npos)
+            {
+                pos = list.size();
+            }
+            if (pos > offset)
+            {
+                items.emplace_back(list.substr(offset, pos - offset));
+            }
+            offset = pos + 1;
         }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
+        return items;
     }
 
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
-
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
-}
-
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
-{
-    slog("Engine::Speak");
-
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
+    // Reads a ';' separated list from the settings key. A missing key or
+    // value is an empty list.
+    std::vector<std::wstring> ReadSettingList(const wchar_t *name)
     {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
+        CRegKey key;
+        if (key.Open(HKEY_LOCAL_MACHINE, settings_key, KEY_READ) != ERROR_SUCCESS)
         {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
+            return {};
         }
 
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
+        ULONG chars = 0;
+        if (key.QueryStringValue(name, nullptr, &chars) != ERROR_SUCCESS)
         {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
+            return {};
         }
 
-        slog("Engine::Speak written={} bytes", written);
-    }
-
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
-}
-
-int Engine::handle_actions(ISpTTSEngineSite *site)
-{
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
-
-    if (actions & SPVES_SKIP)
-    {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
-    }
-
-    if (actions & SPVES_RATE)
-    {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
-    }
-
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
-
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
-
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
+        std::wstring value(chars, L'\0');
+        if (key.QueryStringValue(name, value.data(), &chars) != ERROR_SUCCESS)
+        {
+            return {};
+        }
+        value.resize(wcsnlen(value.c_str(), value.size()));
 
-namespace
-{
+        return SplitList(value);
+    }
+
+    DWORD ReadSettingDword(const wchar_t *name, DWORD default_value)
+    {
+        CRegKey key;
+        DWORD value = 0;
+        if (key.Open(HKEY_LOCAL_MACHINE, settings_key, KEY_READ) != ERROR_SUCCESS ||
+            key.QueryDWORDValue(name, value) != ERROR_SUCCESS)
+        {
+            return default_value;
+        }
+        return value;
+    }
 
-    std::string utf8_encode(const std::wstring &wstr)
+    // The shared voice registry, set up from the engine settings on first use
+    VoiceRegistry &Voices()
     {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
+        static VoiceRegistry &registry = []() -> VoiceRegistry &
+        {
+            auto &registry = VoiceRegistry::instance();
+            registry.set_idle_timeout(std::chrono::seconds(ReadSettingDword(L"VoiceIdleSeconds", 300)));
+            return registry;
+        }();
+        return registry;
     }
 
 } // namespace
 
-HRESULT Engine::FinalConstruct()
+void StartTracing()
 {
-    slog("Engine::FinalConstruct");
-    return S_OK;
+    static std::once_flag once;
+    std::call_once(once, []
+    {
+        trace::Options options;
+#ifndef NDEBUG
+        // Debug builds keep logging everything to the debugger by default
+        options.level = trace::Level::Debug;
+        options.debug_output = true;
+#endif
+        auto file = ReadSettingList(L"TraceFile");
+        if (!file.empty())
+        {
+            options.file = file.front();
+        }
+        options.level = static_cast<trace::Level>(
+            std::min<DWORD>(ReadSettingDword(L"TraceLevel", static_cast<DWORD>(options.level)),
+                            static_cast<DWORD>(trace::Level::Error)));
+        options.categories = static_cast<uint16_t>(ReadSettingDword(L"TraceCategories", options.categories));
+        options.max_file_size = ReadSettingDword(L"TraceFileSizeMB", 16) * uint64_t(1024 * 1024);
+        auto chrome_file = ReadSettingList(L"TraceChromeFile");
+        if (!chrome_file.empty())
+        {
+            options.chrome_file = chrome_file.front();
+        }
+
+        trace::start(options);
+    });
 }
 
-void Engine::FinalRelease()
+void StartMetrics()
 {
-    slog("Engine::FinalRelease");
+    static std::once_flag once;
+    std::call_once(once, []
+    {
+        metrics::Options options;
+        auto file = ReadSettingList(L"MetricsFile");
+        if (!file.empty())
+        {
+            options.file = file.front();
+        }
+        options.interval = std::chrono::seconds(ReadSettingDword(L"MetricsIntervalSeconds", 10));
 
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
+        metrics::start(options);
+    });
 }
 
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
+void StartProfiling()
 {
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
-
-    if (pipe == INVALID_HANDLE_VALUE)
+    static std::once_flag once;
+    std::call_once(once, []
     {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
+        auto file = ReadSettingList(L"ProfileFile");
+        if (file.empty())
+        {
+            return;
+        }
 
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
+        pycpp::profiler::Options options;
+        options.file = file.front();
+        options.interval = std::chrono::milliseconds(std::max<DWORD>(ReadSettingDword(L"ProfileIntervalMs", 10), 1));
+        pycpp::profiler::start(options);
+    });
+}
 
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
+const pycpp::PythonVM::Options &PythonOptions()
+{
+    static const pycpp::PythonVM::Options options = []
+    {
+        pycpp::PythonVM::Options options;
+        options.bundles = ReadSettingList(L"Bundle");
+        options.search_paths = ReadSettingList(L"Path");
+        return options;
+    }();
+    return options;
+}
 
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
+void StartWarmUp()
+{
+    std::vector<std::string> modules;
+    for (const auto &module : ReadSettingList(L"WarmUp"))
+    {
+        modules.push_back(utf8_encode(std::wstring_view(module)));
+    }
 
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
+    auto precompile = ReadSettingList(L"Precompile");
 
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
+    if (!modules.empty() || !precompile.empty())
     {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
+        pycpp::PythonVM::warm_up(PythonOptions(), std::move(precompile), std::move(modules));
     }
+}
 
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
-        {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
-        }
+HRESULT Engine::FinalConstruct()
+{
+    StartTracing();
+    StartMetrics();
+    // After vm_, the sampler needs the interpreter
+    StartProfiling();
+    slog("Engine::FinalConstruct");
+    return S_OK;
+}
 
-        CloseHandle(pipe);
-        return true;
-    }
+void Engine::FinalRelease()
+{
+    slog("Engine::FinalRelease");
 
-    CloseHandle(pipe);
-    return false;
+    // Must end the lease with the GIL held
+    pycpp::ScopedGIL lock;
+    voice_.reset();
 }
 
 HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
@@ -7422,9 +224,27 @@ HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
         return hr;
     }
 
-    CSpDynamicString engine_name; // Add retrieval for engine name
+    voice_label_ = "voice:" + utf8_encode(std::wstring_view(voice_name));
+    voice_stats_ = &metrics::stats(voice_label_);
+
+    // Voices with a plugin are synthesized natively, without Python
+    CSpDynamicString plugin;
+    hr = token_->GetStringValue(L"Plugin", &plugin);
+    if (hr == S_OK)
+    {
+        engine_stats_ = &metrics::stats("plugin:" + std::filesystem::path(plugin.m_psz).filename().string());
+        return load_plugin(plugin);
+    }
+    if (hr != SPERR_NOT_FOUND)
+    {
+        return hr;
+    }
+
+    // Voices with an engine name are synthesized by VoiceServer, the others
+    // by the Python voice object itself
+    CSpDynamicString engine_name;
     hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
+    if (hr != S_OK && hr != SPERR_NOT_FOUND)
     {
         return hr;
     }
@@ -7450,41 +270,75 @@ HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
         return hr;
     }
 
+    // Store the engine name for later use in the Speak method, encoded once
+    // rather than per fragment
+    std::wstring_view engine_name_view = engine_name.m_psz ? engine_name.m_psz : L"";
+    engine_name_ = utf8_encode(engine_name_view);
+
+    engine_stats_ = &metrics::stats(engine_name_.empty() ? "python:" + utf8_encode(std::wstring_view(mod))
+                                                         : "server:" + engine_name_);
+
     slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
+    slog(L"Engine={}", engine_name_view); // Log engine name
     slog(L"Class={}", (const wchar_t *)cls);
 
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
+    // Voices spoken by VoiceServer never use the Python voice object
+    if (!engine_name_.empty())
+    {
+        return hr;
+    }
+
+    CSpDynamicString token_id;
+    hr = token_->GetId(&token_id);
+    if (hr != S_OK)
+    {
+        return hr;
+    }
+
+    // Voices registered again with other settings get a new object
+    auto source = fmt::format(L"{};{};{}", (const wchar_t *)mod, (const wchar_t *)cls, (const wchar_t *)path);
 
     pycpp::ScopedGIL lock;
 
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
+    pycpp::PythonVM::add_search_paths(SplitList(std::wstring_view(path)));
 
-    for (size_t offset = 0;;)
+    // The voice loads in the background, Speak waits for it if needed
+    voice_ = Voices().acquire(std::wstring(token_id), source,
+                              [mod_utf8 = utf8_encode(std::wstring_view(mod)),
+                               cls_utf8 = utf8_encode(std::wstring_view(cls))]
     {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
+        pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
+        pycpp::Obj dict(pycpp::borrowed_ref, PyModule_GetDict(module));
+        pycpp::Obj voice_class(pycpp::borrowed_ref, PyDict_GetItemString(dict, cls_utf8.c_str()));
+        return pycpp::call(voice_class);
+    });
+
+    return hr;
+}
+
+HRESULT Engine::load_plugin(const wchar_t *plugin)
+{
+    CSpDynamicString config;
+    HRESULT hr = token_->GetStringValue(L"PluginConfig", &config);
+    if (hr != S_OK && hr != SPERR_NOT_FOUND)
+    {
+        return hr;
     }
 
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
+    slog(L"Plugin={}", plugin);
 
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
+    try
+    {
+        std::wstring_view config_view = config.m_psz ? config.m_psz : L"";
+        native_voice_ = std::make_unique<NativeVoice>(std::filesystem::path(plugin), utf8_encode(config_view));
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << "Voice plugin error: " << e.what() << "\n";
+        return E_FAIL;
+    }
 
-    return hr;
+    return S_OK;
 }
 
 HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
@@ -7496,348 +350,322 @@ HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
 HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
                                 const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
 {
-    slog("Engine::Speak");
+    request_id_ = trace::new_request_id();
+    TRACE_SPAN(trace::Level::Info, trace::Category::Engine, "Engine::Speak", request_id_);
+    live_stats::Gauge active(&pysapi_stats::active_streams);
+
+    utterance_.start();
+    HRESULT result = S_OK;
+    bool aborted = false;
 
     for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
     {
         if (handle_actions(pOutputSite) == 1)
         {
-            return S_OK;
+            aborted = true;
+            break;
         }
 
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
-
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
+        TRACE(trace::Level::Debug, trace::Category::Engine, "action={}, offset={}, length={}, text=\"{}\"",
+              (int)text_frag->State.eAction,
+              text_frag->ulTextSrcOffset,
+              text_frag->ulTextLen,
+              std::wstring_view(text_frag->pTextStart, text_frag->ulTextLen));
 
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
+        result = native_voice_      ? speak_from_plugin(text_frag, pOutputSite)
+                 : engine_name_.empty() ? speak_from_voice(text_frag, pOutputSite)
+                                        : speak_from_pipe(text_frag, pOutputSite);
 
-        if (!SendRequestToPipe(text, engine_name, audio_data))
+        if (result == S_FALSE)
         {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
+            // Aborted
+            aborted = true;
+            result = S_OK;
+            break;
         }
 
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
+        if (result != S_OK)
         {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
+            break;
         }
-
-        slog("Engine::Speak written={} bytes", written);
     }
 
-    return S_OK;
-}
-
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
-{
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
+    record_utterance(result, aborted, pWaveFormatEx);
+    return result;
 }
 
-int Engine::handle_actions(ISpTTSEngineSite *site)
+void Engine::record_utterance(HRESULT result, bool aborted, const WAVEFORMATEX *format)
 {
-    DWORD actions = site->GetActions();
-
-    if (actions & SPVES_CONTINUE)
-    {
-        slog("CONTINUE");
-    }
-
-    if (actions & SPVES_ABORT)
-    {
-        slog("ABORT");
-        return 1;
-    }
+    utterance_.finish();
 
-    if (actions & SPVES_SKIP)
+    live_stats::add(&pysapi_stats::bytes_streamed, utterance_.bytes_written());
+    if (result == S_OK)
     {
-        SPVSKIPTYPE skip_type;
-        LONG num_items;
-        auto result = site->GetSkipInfo(&skip_type, &num_items);
-        assert(result == S_OK);
-        assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
+        live_stats::add(aborted ? &pysapi_stats::aborted : &pysapi_stats::utterances);
     }
 
-    if (actions & SPVES_RATE)
+    uint32_t bytes_per_sec = format ? format->nAvgBytesPerSec : 0;
+    for (auto *stats : {voice_stats_, engine_stats_, &metrics::total()})
     {
-        LONG rate;
-        auto result = site->GetRate(&rate);
-        assert(result == S_OK);
-        slog("rate={}", rate);
+        if (stats == nullptr)
+        {
+            continue;
+        }
+        if (result != S_OK)
+        {
+            stats->failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (aborted)
+        {
+            stats->aborted.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            stats->record(utterance_, bytes_per_sec);
+        }
     }
 
-    if (actions & SPVES_VOLUME)
-    {
-        USHORT volume;
-        auto result = site->GetVolume(&volume);
-        assert(result == S_OK);
-        slog("volume={}", volume);
-    }
+    auto us = [](uint64_t ns) { return ns / 1000; };
+    TRACE(trace::Level::Info, trace::Category::Audio,
+          "utterance request={:016x} connect={}us request_sent={}us first_byte={}us first_audio={}us last_byte={}us "
+          "total={}us write_stall={}us bytes={} aborted={} result={:#x}",
+          request_id_, us(utterance_.elapsed(metrics::Stage::Connect)), us(utterance_.elapsed(metrics::Stage::RequestSent)),
+          us(utterance_.elapsed(metrics::Stage::FirstByte)), us(utterance_.elapsed(metrics::Stage::FirstAudio)),
+          us(utterance_.elapsed(metrics::Stage::LastByte)), us(utterance_.duration()), us(utterance_.write_stall()),
+          utterance_.bytes_written(), aborted, static_cast<uint32_t>(result));
+}
 
-    return 0;
-}#include "engine.h"
-#include "pycpp.h"
-#include "slog.h"
+HRESULT Engine::speak_from_pipe(const SPVTEXTFRAG *text_frag, ISpTTSEngineSite *site)
+{
+    // Convert the fragment to UTF-8 straight from SAPI's buffer
+    utf8_encode(std::wstring_view(text_frag->pTextStart, text_frag->ulTextLen), text_utf8_);
 
-#include <cassert>
-#include <string_view>
-#include <fmt/format.h>
-#include <fmt/xchar.h>
-#include <iostream>
-#include <sstream>
-#include <json/json.h>
+    HRESULT result = S_OK;
+    ULONG written = 0;
 
-namespace
-{
+    auto speak_result = speak_through_pipe(default_pipe_name, {text_utf8_, engine_name_, request_id_}, audio_ring_,
+                                           utterance_, [&](std::span<const char> block)
+    {
+        result = write_audio(site, block, written);
+        return result == S_OK;
+    });
 
-    std::string utf8_encode(const std::wstring &wstr)
+    switch (speak_result)
     {
-        if (wstr.empty())
-            return std::string();
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-        std::string strTo(size_needed, 0);
-        WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
-        return strTo;
+    case PipeSpeakResult::Ok:
+        break;
+    case PipeSpeakResult::Stopped:
+        return result;
+    case PipeSpeakResult::ConnectFailed:
+        live_stats::add(&pysapi_stats::errors_connect);
+        std::cerr << "Error: Could not connect to pipe server.\n";
+        return E_FAIL;
+    case PipeSpeakResult::SendFailed:
+        live_stats::add(&pysapi_stats::errors_send);
+        std::cerr << "Error writing request to pipe server.\n";
+        return E_FAIL;
+    case PipeSpeakResult::ReadFailed:
+        live_stats::add(&pysapi_stats::errors_read);
+        std::cerr << "Failed to get audio data from pipe server.\n";
+        return E_FAIL;
     }
 
-} // namespace
-
-HRESULT Engine::FinalConstruct()
-{
-    slog("Engine::FinalConstruct");
+    TRACE(trace::Level::Debug, trace::Category::Audio, "Engine::Speak written={} bytes", written);
     return S_OK;
 }
 
-void Engine::FinalRelease()
-{
-    slog("Engine::FinalRelease");
-
-    // Must call reset with the GIL held
-    pycpp::ScopedGIL lock;
-    speak_method_.reset();
-}
-
-// Function to send request to pipe server
-// Function to send request to pipe server
-bool SendRequestToPipe(const std::string &text, const std::string &engine_name, std::vector<char> &audio_data)
+HRESULT Engine::speak_from_voice(const SPVTEXTFRAG *text_frag, ISpTTSEngineSite *site)
 {
-    // Connect to the pipe
-    HANDLE pipe = CreateFile(
-        R"(\\.\pipe\AACSpeakHelper)", // Pipe name
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL);
+    static pycpp::Name speak_name {"speak"};
+    pycpp::profiler::Scope profile(voice_label_);
 
-    if (pipe == INVALID_HANDLE_VALUE)
+    try
     {
-        std::cerr << "Error: Could not connect to pipe server.\n"; // Fixed cerr issue
-        return false;
-    }
-
-    // Create JSON request
-    Json::Value request;
-    request["action"] = "speak";
-    request["text"] = text;
-    request["engine"] = engine_name; // Now passing dynamic engine name
+        // Only blocks if the voice is still loading
+        bool loading = !voice_.ready();
+        const auto &voice = [&]() -> const pycpp::Obj &
+        {
+            TRACE_SPAN(trace::Level::Info, trace::Category::Voice, "voice.wait", request_id_);
+            return voice_.wait();
+        }();
+        utterance_.mark(metrics::Stage::Connect);
+        if (loading)
+        {
+            utterance_.voice_loaded(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(voice_.load_time()).count());
+        }
 
-    std::string request_data = Json::writeString(Json::StreamWriterBuilder(), request);
+        pycpp::Obj chunks;
+        bool async = false;
+        {
+            TRACE_SPAN(trace::Level::Info, trace::Category::Python, "voice.speak", request_id_);
+            pycpp::ScopedGIL lock;
+            pycpp::Obj text {pycpp::convert(std::wstring_view(text_frag->pTextStart, text_frag->ulTextLen))};
+            pycpp::Obj result = pycpp::call_method(voice, speak_name, text);
+            utterance_.mark(metrics::Stage::RequestSent);
 
-    // Send request to the pipe server
-    DWORD bytes_written;
-    WriteFile(pipe, request_data.c_str(), request_data.size(), &bytes_written, NULL);
+            // asyncio voices return an async generator. The result only
+            // leaves this scope by a move, so if it is not iterable it is
+            // still released with the GIL held.
+            async = PyAIter_Check(result);
+            chunks = async ? std::move(result) : pycpp::Obj(PyObject_GetIter(result));
+        }
 
-    // Read response from the pipe
-    char buffer[65536];
-    DWORD bytes_read;
-    ReadFile(pipe, buffer, sizeof(buffer), &bytes_read, NULL);
+        ULONG written = 0;
 
-    // Fix the JSON deserialization using a stringstream
-    std::istringstream response_data(std::string(buffer, bytes_read));
-    Json::Value response;
-    Json::CharReaderBuilder reader;
-    std::string errors;
+        // Chunks are written to the site without holding the GIL
+        auto write_chunks = [&](auto &&range) -> HRESULT
+        {
+            for (const auto &chunk : range)
+            {
+                // One chunk in 16: a voice may produce hundreds per utterance
+                if constexpr (requires { chunk.pull_time; })
+                {
+                    TRACE_SAMPLED(16, trace::Level::Debug, trace::Category::Audio,
+                                  "Engine::Speak chunk={} bytes, pull={}us", chunk.data.size(),
+                                  std::chrono::duration_cast<std::chrono::microseconds>(chunk.pull_time).count());
+                }
+                else
+                {
+                    TRACE_SAMPLED(16, trace::Level::Debug, trace::Category::Audio,
+                                  "Engine::Speak chunk={} bytes, wait={}us", chunk.data.size(),
+                                  std::chrono::duration_cast<std::chrono::microseconds>(chunk.wait_time).count());
+                }
 
-    if (!Json::parseFromStream(reader, response_data, &response, &errors)) // Correcting this part
-    {
-        std::cerr << "Error parsing response from pipe server: " << errors << std::endl;
-        CloseHandle(pipe);
-        return false;
-    }
+                utterance_.received(chunk.data.size());
+                auto data = std::span<const char>(reinterpret_cast<const char *>(chunk.data.data()), chunk.data.size());
+                HRESULT result = write_audio(site, data, written);
+                if (result != S_OK)
+                {
+                    return result;
+                }
+            }
+            return S_OK;
+        };
 
-    if (response["status"] == "success")
-    {
-        // Extract audio data
-        const Json::Value &audio_chunks = response["audio_data"];
-        for (const auto &chunk : audio_chunks)
+        // Generators are pulled in batches on this thread, async generators
+        // are driven by the shared event loop thread
+        HRESULT result = async
+            ? write_chunks(pycpp::AsyncIter {std::move(chunks)})
+            : write_chunks(pycpp::Iter {std::move(chunks)});
+        if (result != S_OK)
         {
-            std::string chunk_data = chunk.asString(); // Correctly extract string from JSON
-            audio_data.insert(audio_data.end(), chunk_data.begin(), chunk_data.end());
+            return result;
         }
 
-        CloseHandle(pipe);
-        return true;
+        TRACE(trace::Level::Debug, trace::Category::Audio, "Engine::Speak written={} bytes", written);
+        return S_OK;
+    }
+    catch (const pycpp::PythonException &e)
+    {
+        live_stats::add(&pysapi_stats::errors_voice);
+        std::cerr << "Voice error: " << e.what() << "\n";
+        return E_FAIL;
     }
-
-    CloseHandle(pipe);
-    return false;
 }
 
-HRESULT __stdcall Engine::SetObjectToken(ISpObjectToken *pToken)
+HRESULT Engine::speak_from_plugin(const SPVTEXTFRAG *text_frag, ISpTTSEngineSite *site)
 {
-    slog("Engine::SetObjectToken");
+    utf8_encode(std::wstring_view(text_frag->pTextStart, text_frag->ulTextLen), text_utf8_);
 
-    HRESULT hr = SpGenericSetObjectToken(pToken, token_);
-    assert(hr == S_OK);
+    ULONG written = 0;
+    HRESULT result = S_OK;
 
-    CSpDynamicString voice_name;
-    hr = token_->GetStringValue(L"", &voice_name);
-    if (hr != S_OK)
+    try
     {
-        return hr;
+        // Audio is written to the site straight from the plugin's buffers
+        TRACE_SPAN(trace::Level::Info, trace::Category::Voice, "plugin.speak", request_id_);
+        utterance_.mark(metrics::Stage::RequestSent);
+        native_voice_->speak(text_utf8_, [&](std::span<const char> data)
+        {
+            utterance_.received(data.size());
+            result = write_audio(site, data, written);
+            return result == S_OK;
+        });
     }
-
-    CSpDynamicString engine_name; // Add retrieval for engine name
-    hr = token_->GetStringValue(L"Engine", &engine_name);
-    if (hr != S_OK)
+    catch (const std::runtime_error &e)
     {
-        return hr;
+        live_stats::add(&pysapi_stats::errors_plugin);
+        std::cerr << "Voice error: " << e.what() << "\n";
+        return E_FAIL;
     }
 
-    CSpDynamicString path;
-    hr = token_->GetStringValue(L"Path", &path);
-    if (hr != S_OK)
-    {
-        return hr;
-    }
+    TRACE(trace::Level::Debug, trace::Category::Audio, "Engine::Speak written={} bytes", written);
+    return result;
+}
 
-    CSpDynamicString mod;
-    hr = token_->GetStringValue(L"Module", &mod);
-    if (hr != S_OK)
+// Writes one block of audio. Returns S_FALSE if SAPI asked to abort.
+HRESULT Engine::write_audio(ISpTTSEngineSite *site, std::span<const char> data, ULONG &written)
+{
+    if (handle_actions(site) == 1)
     {
-        return hr;
+        return S_FALSE;
     }
 
-    CSpDynamicString cls;
-    hr = token_->GetStringValue(L"Class", &cls);
-    if (hr != S_OK)
+    // Write audio data to the output
+    // The site blocks once its queue is full, at playback speed
+    ULONG block_written;
+    uint64_t begin = trace::Clock::now();
+    HRESULT result;
     {
-        return hr;
+        TRACE_SPAN(trace::Level::Info, trace::Category::Audio, "site.write", request_id_);
+        result = site->Write(data.data(), data.size(), &block_written);
     }
-
-    slog(L"Path={}", (const wchar_t *)path);
-    slog(L"Engine={}", (const wchar_t *)engine_name); // Log engine name
-    slog(L"Class={}", (const wchar_t *)cls);
-
-    // Store the engine name for later use in the Speak method
-    engine_name_ = std::wstring(engine_name);
-
-    pycpp::ScopedGIL lock;
-
-    // Append to sys.path
-    std::wstring_view path_view{(const wchar_t *)path, path.Length()};
-
-    for (size_t offset = 0;;)
+    uint64_t stall = trace::Clock::now() - begin;
+    if (result != S_OK || block_written != data.size())
     {
-        auto pos = path_view.find(L';', offset);
-        if (pos == std::wstring_view::npos)
-        {
-            pycpp::append_to_syspath(path_view.substr(offset));
-            break;
-        }
-        pycpp::append_to_syspath(path_view.substr(offset, pos - offset));
-        offset += pos + 1;
+        live_stats::add(&pysapi_stats::errors_write);
+        std::cerr << "Error writing audio data to output site.\n";
+        return E_FAIL;
     }
 
-    auto mod_utf8 = utf8_encode((const wchar_t *)mod);
-    auto cls_utf8 = utf8_encode((const wchar_t *)cls);
-
-    // Initialize voice
-    pycpp::Obj module{PyImport_ImportModule(mod_utf8.c_str())};
-    pycpp::Obj dict(pycpp::incref(PyModule_GetDict(module)));
-    pycpp::Obj voice_class(pycpp::incref(PyDict_GetItemString(dict, cls_utf8.c_str())));
-    pycpp::Obj voice_object(PyObject_CallNoArgs(voice_class));
-    speak_method_ = PyObject_GetAttrString(voice_object, "speak");
-
-    return hr;
-}
+    utterance_.written(block_written, stall);
 
-HRESULT __stdcall Engine::GetObjectToken(ISpObjectToken **ppToken)
-{
-    slog("Engine::GetObjectToken");
-    return SpGenericGetObjectToken(ppToken, token_);
+    written += block_written;
+    return S_OK;
 }
 
-HRESULT __stdcall Engine::Speak(DWORD dwSpeakFlags, REFGUID rguidFormatId, const WAVEFORMATEX *pWaveFormatEx,
-                                const SPVTEXTFRAG *pTextFragList, ISpTTSEngineSite *pOutputSite)
+HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
+                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
 {
-    slog("Engine::Speak");
+    slog("Engine::GetOutputFormat");
 
-    for (const auto *text_frag = pTextFragList; text_frag != nullptr; text_frag = text_frag->pNext)
+    // Plugins declare their format
+    if (native_voice_)
     {
-        if (handle_actions(pOutputSite) == 1)
-        {
-            return S_OK;
-        }
-
-        slog(L"action={}, offset={}, length={}, text=\"{}\"",
-             (int)text_frag->State.eAction,
-             text_frag->ulTextSrcOffset,
-             text_frag->ulTextLen,
-             text_frag->pTextStart);
+        const auto &format = native_voice_->format();
 
-        // Convert wide string to UTF-8
-        std::string text = utf8_encode(std::wstring(text_frag->pTextStart, text_frag->ulTextLen));
-
-        std::vector<char> audio_data;
-
-        // Convert engine_name_ from wstring to string before passing
-        std::string engine_name = utf8_encode(engine_name_);
-
-        if (!SendRequestToPipe(text, engine_name, audio_data))
+        auto *wave_format = static_cast<WAVEFORMATEX *>(CoTaskMemAlloc(sizeof(WAVEFORMATEX)));
+        if (wave_format == nullptr)
         {
-            std::cerr << "Failed to get audio data from pipe server.\n";
-            return E_FAIL;
+            return E_OUTOFMEMORY;
         }
 
-        // Write audio data to the output
-        ULONG written;
-        HRESULT result = pOutputSite->Write(audio_data.data(), audio_data.size(), &written);
-        if (result != S_OK || written != audio_data.size())
-        {
-            std::cerr << "Error writing audio data to output site.\n";
-            return E_FAIL;
-        }
+        wave_format->wFormatTag = WAVE_FORMAT_PCM;
+        wave_format->nChannels = format.channels;
+        wave_format->nSamplesPerSec = format.samples_per_sec;
+        wave_format->wBitsPerSample = format.bits_per_sample;
+        wave_format->nBlockAlign = static_cast<WORD>(format.channels * format.bits_per_sample / 8);
+        wave_format->nAvgBytesPerSec = format.samples_per_sec * wave_format->nBlockAlign;
+        wave_format->cbSize = 0;
 
-        slog("Engine::Speak written={} bytes", written);
+        *pDesiredFormatId = SPDFID_WaveFormatEx;
+        *ppCoMemDesiredWaveFormatEx = wave_format;
+        return S_OK;
     }
 
-    return S_OK;
+    // FIXME: Query audio format from Python voice
+    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
 }
 
-HRESULT __stdcall Engine::GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
-                                          GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx)
+HRESULT __stdcall Engine::GetStats(BYTE *stats, ULONG size, ULONG *written)
 {
-    slog("Engine::GetOutputFormat");
-    // FIXME: Query audio format from Python voice
-    return SpConvertStreamFormatEnum(SPSF_24kHz16BitMono, pDesiredFormatId, ppCoMemDesiredWaveFormatEx);
+    if (stats == nullptr || written == nullptr)
+    {
+        return E_POINTER;
+    }
+    *written = static_cast<ULONG>(pysapi_get_stats(reinterpret_cast<pysapi_stats *>(stats), size));
+    return S_OK;
 }
 
 int Engine::handle_actions(ISpTTSEngineSite *site)
@@ -7846,12 +674,12 @@ int Engine::handle_actions(ISpTTSEngineSite *site)
 
     if (actions & SPVES_CONTINUE)
     {
-        slog("CONTINUE");
+        TRACE(trace::Level::Debug, trace::Category::Engine, "CONTINUE");
     }
 
     if (actions & SPVES_ABORT)
     {
-        slog("ABORT");
+        TRACE(trace::Level::Info, trace::Category::Engine, "ABORT");
         return 1;
     }
 
@@ -7862,7 +690,7 @@ int Engine::handle_actions(ISpTTSEngineSite *site)
         auto result = site->GetSkipInfo(&skip_type, &num_items);
         assert(result == S_OK);
         assert(skip_type == SPVST_SENTENCE);
-        slog("num_items={}", num_items);
+        TRACE(trace::Level::Debug, trace::Category::Engine, "num_items={}", num_items);
     }
 
     if (actions & SPVES_RATE)
@@ -7870,7 +698,7 @@ int Engine::handle_actions(ISpTTSEngineSite *site)
         LONG rate;
         auto result = site->GetRate(&rate);
         assert(result == S_OK);
-        slog("rate={}", rate);
+        TRACE(trace::Level::Debug, trace::Category::Engine, "rate={}", rate);
     }
 
     if (actions & SPVES_VOLUME)
@@ -7878,7 +706,7 @@ int Engine::handle_actions(ISpTTSEngineSite *site)
         USHORT volume;
         auto result = site->GetVolume(&volume);
         assert(result == S_OK);
-        slog("volume={}", volume);
+        TRACE(trace::Level::Debug, trace::Category::Engine, "volume={}", volume);
     }
 
     return 0;
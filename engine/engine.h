@@ -7,15 +7,41 @@
 #include <spcollec.h>
 #include <spddkhlp.h>
 #include <iostream>
+#include <memory>
+#include <span>
 
 #include "pysapittsengine.h"
 #include "resource.h"
 #include "pycpp.h"
+#include "audio_ring.h"
+#include "metrics.h"
+#include "native_voice.h"
+#include "voice_registry.h"
+
+// Configures tracing from the TraceFile, TraceLevel, TraceCategories and
+// TraceFileSizeMB settings, once
+void StartTracing();
+
+// Interpreter settings read from HKLM\SOFTWARE\PySAPITTSEngine
+const pycpp::PythonVM::Options &PythonOptions();
+
+// Configures the metrics report file from the MetricsFile and
+// MetricsIntervalSeconds settings, once
+void StartMetrics();
+
+// Opt-in: samples the Python stacks of the voices into the ProfileFile
+// setting every ProfileIntervalMs, once
+void StartProfiling();
+
+// Opt-in: imports the modules listed in the WarmUp setting in the
+// background, so the first voice loads faster
+void StartWarmUp();
 
 class ATL_NO_VTABLE Engine : public CComObjectRootEx<CComMultiThreadModel>,
                              public CComCoClass<Engine, &CLSID_PySAPITTSEngine>,
                              public ISpTTSEngine,
-                             public ISpObjectWithToken
+                             public ISpObjectWithToken,
+                             public IPySAPIStats
 {
 public:
     DECLARE_REGISTRY_RESOURCEID(IDR_PYSAPITTSENGINE)
@@ -24,6 +50,7 @@ public:
     BEGIN_COM_MAP(Engine)
     COM_INTERFACE_ENTRY(ISpTTSEngine)
     COM_INTERFACE_ENTRY(ISpObjectWithToken)
+    COM_INTERFACE_ENTRY(IPySAPIStats)
     END_COM_MAP()
 
     HRESULT FinalConstruct();
@@ -39,16 +66,48 @@ public:
     HRESULT __stdcall GetOutputFormat(const GUID *pTargetFormatId, const WAVEFORMATEX *pTargetWaveFormatEx,
                                       GUID *pDesiredFormatId, WAVEFORMATEX **ppCoMemDesiredWaveFormatEx);
 
+    // IPySAPIStats
+    HRESULT __stdcall GetStats(BYTE *stats, ULONG size, ULONG *written);
+
 private:
     CComPtr<ISpObjectToken> token_;
-    pycpp::PythonVM vm_;
+    pycpp::PythonVM vm_ {PythonOptions()};
 
-    // TTS methods
-    pycpp::Obj speak_method_;
+    // TTS voice object shared through the VoiceRegistry, its speak() is
+    // called through pycpp::call_method
+    VoiceRegistry::Lease voice_;
+
+    // Set instead for voices implemented by a native plugin
+    std::unique_ptr<NativeVoice> native_voice_;
 
     // New member for storing the engine name dynamically
-    std::wstring engine_name_;
+    std::string engine_name_;
+
+    // UTF-8 text of the fragment being spoken, reused across fragments
+    std::string text_utf8_;
+
+    // Audio received from the pipe server, waiting to be written to the site
+    AudioRing audio_ring_ {8, 32 * 1024};
+
+    // Id of the Speak call in progress, sent to VoiceServer and attached to
+    // the trace spans of both processes
+    uint64_t request_id_ = 0;
+
+    // Timeline of the Speak call in progress, recorded into the stats of
+    // the voice, of its engine and of the process when it ends
+    metrics::Utterance utterance_;
+    // "voice:<name>", also labels the voice's stacks in the profile
+    std::string voice_label_;
+    metrics::Stats *voice_stats_ = nullptr;
+    metrics::Stats *engine_stats_ = nullptr;
+
+    HRESULT load_plugin(const wchar_t *plugin);
 
     // TTS helper methods
+    HRESULT speak_from_pipe(const SPVTEXTFRAG *text_frag, ISpTTSEngineSite *site);
+    HRESULT speak_from_voice(const SPVTEXTFRAG *text_frag, ISpTTSEngineSite *site);
+    HRESULT speak_from_plugin(const SPVTEXTFRAG *text_frag, ISpTTSEngineSite *site);
+    HRESULT write_audio(ISpTTSEngineSite *site, std::span<const char> data, ULONG &written);
+    void record_utterance(HRESULT result, bool aborted, const WAVEFORMATEX *format);
     int handle_actions(ISpTTSEngineSite *site);
 };
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "live_stats.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <tlhelp32.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(alignof(pysapi_stats) >= std::atomic_ref<uint64_t>::required_alignment,
+              "pysapi_stats fields must be usable with atomic_ref");
+
+namespace {
+
+uint64_t current_pid() {
+#if defined(_WIN32)
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint64_t>(getpid());
+#endif
+}
+
+uint64_t load(const uint64_t& field) noexcept {
+    // Mapped read-only by readers: a load never writes
+    return std::atomic_ref(const_cast<uint64_t&>(field)).load(std::memory_order_relaxed);
+}
+
+#if defined(_WIN32)
+
+std::wstring mapping_name(uint64_t pid) {
+    return fmt::format(L"{}{}", L"" PYSAPI_STATS_WINDOWS_PREFIX, pid);
+}
+
+// The handle is never closed: the block lives as long as the process
+pysapi_stats* create_block() {
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(pysapi_stats),
+                                        mapping_name(current_pid()).c_str());
+    if (mapping == NULL) {
+        return nullptr;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(pysapi_stats));
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return nullptr;
+    }
+    return static_cast<pysapi_stats*>(view);
+}
+
+#else
+
+std::string shm_name(uint64_t pid) {
+    return fmt::format("{}{}", PYSAPI_STATS_POSIX_PREFIX, pid);
+}
+
+void unlink_block() {
+    shm_unlink(shm_name(current_pid()).c_str());
+}
+
+pysapi_stats* create_block() {
+    auto name = shm_name(current_pid());
+    int fd = shm_open(name.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, sizeof(pysapi_stats)) == 0) {
+        view = mmap(nullptr, sizeof(pysapi_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    std::atexit(unlink_block);
+    return static_cast<pysapi_stats*>(view);
+}
+
+#endif
+
+pysapi_stats* publish() {
+    pysapi_stats* stats = create_block();
+    if (stats == nullptr) {
+        stats = new pysapi_stats {};
+    }
+    stats->version = PYSAPI_STATS_VERSION;
+    stats->pid = current_pid();
+    // Written last: readers take a zero size as not ready yet
+    std::atomic_ref(stats->size).store(sizeof(pysapi_stats), std::memory_order_release);
+    return stats;
+}
+
+} // namespace
+
+pysapi_stats& live_stats::block() noexcept {
+    // Never unmapped: counters may be bumped while the process exits
+    static pysapi_stats* stats = publish();
+    return *stats;
+}
+
+size_t live_stats::snapshot(const pysapi_stats& from, pysapi_stats& to, size_t size) noexcept {
+    pysapi_stats copy {};
+    size_t from_size = std::atomic_ref(const_cast<uint64_t&>(from.size)).load(std::memory_order_acquire);
+    copy.size = std::min<size_t>(from_size, sizeof(pysapi_stats));
+    copy.version = load(from.version);
+    copy.pid = load(from.pid);
+
+#define PYSAPI_STATS_COPY(name, kind, description)          \
+    if (offsetof(pysapi_stats, name) < copy.size) {         \
+        copy.name = load(from.name);                        \
+    }
+    PYSAPI_STATS_FIELDS(PYSAPI_STATS_COPY)
+#undef PYSAPI_STATS_COPY
+
+    size = std::min<size_t>(size, sizeof(pysapi_stats));
+    std::memcpy(&to, &copy, size);
+    return size;
+}
+
+#if defined(_WIN32)
+
+std::vector<uint64_t> live_stats::published() {
+    std::vector<uint64_t> pids;
+    HANDLE processes = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (processes == INVALID_HANDLE_VALUE) {
+        return pids;
+    }
+    PROCESSENTRY32W entry {sizeof(entry)};
+    for (BOOL ok = Process32FirstW(processes, &entry); ok; ok = Process32NextW(processes, &entry)) {
+        HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, mapping_name(entry.th32ProcessID).c_str());
+        if (mapping != NULL) {
+            CloseHandle(mapping);
+            pids.push_back(entry.th32ProcessID);
+        }
+    }
+    CloseHandle(processes);
+    return pids;
+}
+
+bool live_stats::read(uint64_t pid, pysapi_stats& stats) {
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, mapping_name(pid).c_str());
+    if (mapping == NULL) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) {
+        return false;
+    }
+    snapshot(*static_cast<const pysapi_stats*>(view), stats);
+    UnmapViewOfFile(view);
+    return stats.size != 0;
+}
+
+#else
+
+std::vector<uint64_t> live_stats::published() {
+    // Blocks show up as files in /dev/shm on Linux; elsewhere only read()
+    // with a known pid works
+    std::vector<uint64_t> pids;
+    std::error_code error;
+    std::string_view prefix = PYSAPI_STATS_POSIX_PREFIX + 1;
+    for (const auto& entry : std::filesystem::directory_iterator("/dev/shm", error)) {
+        auto name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        uint64_t pid = std::strtoull(name.c_str() + prefix.size(), nullptr, 10);
+        // Left behind by a process that crashed
+        if (pid == 0 || (kill(static_cast<pid_t>(pid), 0) != 0 && errno != EPERM)) {
+            continue;
+        }
+        pids.push_back(pid);
+    }
+    std::sort(pids.begin(), pids.end());
+    return pids;
+}
+
+bool live_stats::read(uint64_t pid, pysapi_stats& stats) {
+    int fd = shm_open(shm_name(pid).c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    void* view = mmap(nullptr, sizeof(pysapi_stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    snapshot(*static_cast<const pysapi_stats*>(view), stats);
+    munmap(view, sizeof(pysapi_stats));
+    return stats.size != 0;
+}
+
+#endif
+
+size_t pysapi_get_stats(pysapi_stats* stats, size_t size) {
+    if (stats == nullptr) {
+        return 0;
+    }
+    return live_stats::snapshot(live_stats::block(), *stats, size);
+}
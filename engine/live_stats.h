@@ -0,0 +1,56 @@
+#pragma once
+
+#include "pysapi_stats.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Writer and reader side of pysapi_stats.h. The engine bumps fields with
+// add() and Gauge; pysapistat reads other processes with read().
+namespace live_stats {
+
+using Field = uint64_t pysapi_stats::*;
+
+// Counters of this process, published in shared memory on first use. Falls
+// back to private memory if the block cannot be created.
+pysapi_stats& block() noexcept;
+
+inline void add(Field field, uint64_t n = 1) noexcept {
+    std::atomic_ref(block().*field).fetch_add(n, std::memory_order_relaxed);
+}
+
+inline void sub(Field field, uint64_t n = 1) noexcept {
+    std::atomic_ref(block().*field).fetch_sub(n, std::memory_order_relaxed);
+}
+
+// Raises a gauge for its lifetime
+class Gauge {
+public:
+    explicit Gauge(Field field) noexcept : field_(field) {
+        add(field_);
+    }
+
+    ~Gauge() {
+        sub(field_);
+    }
+
+    Gauge(const Gauge&) = delete;
+    Gauge& operator=(const Gauge&) = delete;
+
+private:
+    Field field_;
+};
+
+// Copies `from`, which another thread or process may be updating, field by
+// field. Fields `from` was built without are left zero. Returns the number
+// of bytes of `to` filled in, at most `size`.
+size_t snapshot(const pysapi_stats& from, pysapi_stats& to, size_t size = sizeof(pysapi_stats)) noexcept;
+
+// Processes that have published counters
+std::vector<uint64_t> published();
+
+// Reads the counters of process `pid`. Returns false if it has none.
+bool read(uint64_t pid, pysapi_stats& stats);
+
+} // namespace live_stats
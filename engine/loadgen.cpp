@@ -0,0 +1,366 @@
+// Load generator for the pipe server. Drives the engine's own pipe client
+// (pipe_client.h) from many sessions at once, the way concurrent SAPI
+// clients would, and reports throughput, time to first audio and real-time
+// factor. Runs on Windows against VoiceServer and on Linux against a
+// stand-in server listening on pipe_path(name).
+//
+// Closed loop (the default): each session sends its next request as soon
+// as the previous one has finished.
+//
+// Open loop (--rate): requests arrive in a Poisson process whatever the
+// server's speed, and wait for a free session if needed. Times are counted
+// from when a request was due, so queueing shows up in the results instead
+// of slowing the arrivals down.
+
+#include "audio_ring.h"
+#include "metrics.h"
+#include "pipe_client.h"
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+namespace {
+
+struct Settings {
+    std::string pipe = default_pipe_name;
+    std::string engine;
+    std::string corpus;
+    std::string trace_file;
+    unsigned concurrency = 4;
+    double rate = 0;
+    double duration = 10;
+    uint64_t requests = 0;
+    uint32_t bytes_per_sec = 48000;
+    bool realtime = false;
+    bool json = false;
+};
+
+const char* usage = R"(Usage: loadgen [options]
+  --pipe NAME           server pipe name (AACSpeakHelper)
+  --engine NAME         engine name sent with each request
+  --corpus FILE         text to speak, one utterance per line
+  --concurrency N       simultaneous sessions (4)
+  --rate R              open loop, R requests per second on average;
+                        closed loop when 0 (default)
+  --duration S          seconds to send requests for (10)
+  --requests N          stop after N requests instead
+  --bytes-per-sec B     audio byte rate, for the real-time factor
+                        (48000, 24 kHz 16-bit mono)
+  --realtime            consume audio at playback speed, like SAPI does
+  --trace FILE          write request spans to a Chrome trace file
+  --json                print the results as JSON
+)";
+
+const std::vector<std::string> default_corpus = {
+    "Hello, World!",
+    "The quick brown fox jumps over the lazy dog.",
+    "Please call Stella. Ask her to bring these things with her from the store.",
+    "It is twenty past seven on Tuesday the fourth of March.",
+    "Six spoons of fresh snow peas, five thick slabs of blue cheese, and maybe a snack for her brother Bob.",
+};
+
+struct Job {
+    // trace::Clock time the request was due
+    uint64_t due;
+    size_t text;
+};
+
+// Requests waiting for a session, open loop only
+class JobQueue {
+public:
+    void push(const Job& job) {
+        {
+            std::lock_guard lock(mutex_);
+            jobs_.push_back(job);
+        }
+        ready_.notify_one();
+    }
+
+    void close() {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+    // Returns false once closed and empty
+    bool pop(Job& job) {
+        std::unique_lock lock(mutex_);
+        ready_.wait(lock, [&] { return closed_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+            return false;
+        }
+        job = jobs_.front();
+        jobs_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Job> jobs_;
+    bool closed_ = false;
+};
+
+struct Results {
+    metrics::Stats stats;
+    std::atomic<uint64_t> ok {0};
+    std::atomic<uint64_t> failed {0};
+    std::atomic<uint64_t> bytes {0};
+};
+
+void sleep_until(uint64_t time) {
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(time)));
+}
+
+// One client session: its own ring, like one Engine instance
+class Session {
+public:
+    Session(const Settings& settings, const std::vector<std::string>& corpus, Results& results)
+        : settings_(settings), corpus_(corpus), results_(results) {}
+
+    void speak(const Job& job) {
+        utterance_.start(job.due);
+
+        // With --realtime a write blocks until the audio before it has played
+        uint64_t playback_start = 0;
+        uint64_t written = 0;
+
+        SpeakRequest request {corpus_[job.text], settings_.engine, trace::new_request_id()};
+        auto result = speak_through_pipe(settings_.pipe, request, ring_, utterance_, [&](std::span<const char> block) {
+            uint64_t begin = trace::Clock::now();
+            if (settings_.realtime) {
+                if (playback_start == 0) {
+                    playback_start = begin;
+                }
+                sleep_until(playback_start + written * 1'000'000'000 / settings_.bytes_per_sec);
+            }
+            written += block.size();
+            utterance_.written(block.size(), trace::Clock::now() - begin);
+            return true;
+        });
+        utterance_.finish();
+
+        // A server that hangs up without audio has failed too, though the
+        // protocol cannot tell that from an empty answer
+        if (result != PipeSpeakResult::Ok || utterance_.bytes_written() == 0) {
+            results_.failed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        results_.stats.record(utterance_, settings_.bytes_per_sec);
+        results_.ok.fetch_add(1, std::memory_order_relaxed);
+        results_.bytes.fetch_add(utterance_.bytes_written(), std::memory_order_relaxed);
+    }
+
+private:
+    const Settings& settings_;
+    const std::vector<std::string>& corpus_;
+    Results& results_;
+    AudioRing ring_ {8, 32 * 1024};
+    metrics::Utterance utterance_;
+};
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    auto number = [](const char* value) {
+        size_t end = 0;
+        double result = std::stod(value, &end);
+        if (value[end] != '\0' || result < 0) {
+            throw std::invalid_argument(value);
+        }
+        return result;
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--pipe" && has_value) {
+            settings.pipe = argv[++i];
+        } else if (arg == "--engine" && has_value) {
+            settings.engine = argv[++i];
+        } else if (arg == "--corpus" && has_value) {
+            settings.corpus = argv[++i];
+        } else if (arg == "--concurrency" && has_value) {
+            settings.concurrency = static_cast<unsigned>(number(argv[++i]));
+        } else if (arg == "--rate" && has_value) {
+            settings.rate = number(argv[++i]);
+        } else if (arg == "--duration" && has_value) {
+            settings.duration = number(argv[++i]);
+        } else if (arg == "--requests" && has_value) {
+            settings.requests = static_cast<uint64_t>(number(argv[++i]));
+        } else if (arg == "--bytes-per-sec" && has_value) {
+            settings.bytes_per_sec = static_cast<uint32_t>(number(argv[++i]));
+        } else if (arg == "--trace" && has_value) {
+            settings.trace_file = argv[++i];
+        } else if (arg == "--realtime") {
+            settings.realtime = true;
+        } else if (arg == "--json") {
+            settings.json = true;
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+
+    if (settings.concurrency == 0 || settings.bytes_per_sec == 0) {
+        throw std::invalid_argument("--concurrency and --bytes-per-sec must not be 0");
+    }
+    return settings;
+}
+
+std::vector<std::string> read_corpus(const std::string& path) {
+    if (path.empty()) {
+        return default_corpus;
+    }
+
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    std::vector<std::string> corpus;
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            corpus.push_back(std::move(line));
+        }
+    }
+    if (corpus.empty()) {
+        throw std::runtime_error(path + " has no text");
+    }
+    return corpus;
+}
+
+void print_results(const Settings& settings, const Results& results, double elapsed) {
+    const auto& first_audio = results.stats.stages[size_t(metrics::Stage::FirstAudio)];
+    const auto& rtf = results.stats.real_time_factor;
+    uint64_t ok = results.ok.load();
+    double throughput = ok / elapsed;
+    double audio_throughput = double(results.bytes.load()) / settings.bytes_per_sec / elapsed;
+
+    // Histograms hold microseconds and thousandths
+    auto ms = [](uint64_t us) { return us / 1000.0; };
+    auto factor = [](uint64_t thousandths) { return thousandths / 1000.0; };
+
+    if (settings.json) {
+        fmt::print(R"({{"mode":"{}","concurrency":{},"rate":{},"ok":{},"failed":{},"elapsed_s":{:.3f},)"
+                   R"("throughput":{:.3f},"audio_throughput":{:.3f},)"
+                   R"("first_audio_ms":{{"p50":{:.3f},"p99":{:.3f},"p999":{:.3f},"max":{:.3f}}},)"
+                   R"("real_time_factor":{{"p50":{:.3f},"p99":{:.3f},"p999":{:.3f},"max":{:.3f}}}}})"
+                   "\n",
+                   settings.rate > 0 ? "open" : "closed", settings.concurrency, settings.rate, ok,
+                   results.failed.load(), elapsed, throughput, audio_throughput, ms(first_audio.percentile(50)),
+                   ms(first_audio.percentile(99)), ms(first_audio.percentile(99.9)), ms(first_audio.max()),
+                   factor(rtf.percentile(50)), factor(rtf.percentile(99)), factor(rtf.percentile(99.9)),
+                   factor(rtf.max()));
+        return;
+    }
+
+    fmt::print("requests          {} ok, {} failed in {:.2f} s ({} loop, {} sessions", ok, results.failed.load(),
+               elapsed, settings.rate > 0 ? "open" : "closed", settings.concurrency);
+    if (settings.rate > 0) {
+        fmt::print(", {:.1f}/s", settings.rate);
+    }
+    fmt::print(")\n");
+    fmt::print("throughput        {:.2f} utterances/s, {:.2f} s of audio/s\n", throughput, audio_throughput);
+    fmt::print("{:<16} {:>10} {:>10} {:>10} {:>10}\n", "", "p50", "p99", "p99.9", "max");
+    fmt::print("{:<16} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}\n", "first audio ms", ms(first_audio.percentile(50)),
+               ms(first_audio.percentile(99)), ms(first_audio.percentile(99.9)), ms(first_audio.max()));
+    fmt::print("{:<16} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}\n", "real-time factor", factor(rtf.percentile(50)),
+               factor(rtf.percentile(99)), factor(rtf.percentile(99.9)), factor(rtf.max()));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    std::vector<std::string> corpus;
+    try {
+        settings = parse_args(argc, argv);
+        corpus = read_corpus(settings.corpus);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    if (!settings.trace_file.empty()) {
+        trace::Options options;
+        options.chrome_file = settings.trace_file;
+        options.level = trace::Level::Info;
+        trace::start(options);
+    }
+
+    Results results;
+    std::atomic<uint64_t> issued {0};
+    const uint64_t start = trace::Clock::now();
+    const uint64_t end = start + static_cast<uint64_t>(settings.duration * 1e9);
+
+    // Claims the next request, or returns false when the run is over
+    auto next_request = [&](uint64_t due, Job& job) {
+        uint64_t n = issued.fetch_add(1, std::memory_order_relaxed);
+        if (settings.requests ? n >= settings.requests : due >= end) {
+            return false;
+        }
+        job = {due, n % corpus.size()};
+        return true;
+    };
+
+    JobQueue queue;
+    std::vector<std::thread> sessions;
+    for (unsigned i = 0; i < settings.concurrency; i++) {
+        sessions.emplace_back([&] {
+            Session session(settings, corpus, results);
+            Job job;
+            if (settings.rate > 0) {
+                while (queue.pop(job)) {
+                    session.speak(job);
+                }
+            } else {
+                while (next_request(trace::Clock::now(), job)) {
+                    session.speak(job);
+                }
+            }
+        });
+    }
+
+    if (settings.rate > 0) {
+        std::mt19937_64 random(std::random_device {}());
+        std::exponential_distribution<double> interval(settings.rate);
+        uint64_t due = start;
+        Job job;
+        while (next_request(due, job)) {
+            sleep_until(due);
+            queue.push(job);
+            due += static_cast<uint64_t>(interval(random) * 1e9);
+        }
+        queue.close();
+    }
+
+    for (auto& session : sessions) {
+        session.join();
+    }
+
+    double elapsed = (trace::Clock::now() - start) / 1e9;
+    print_results(settings, results, elapsed);
+    trace::flush();
+    return results.failed.load() == 0 ? 0 : 1;
+}
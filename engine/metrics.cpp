@@ -0,0 +1,207 @@
+#include "metrics.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <fmt/format.h>
+
+using namespace metrics;
+
+namespace {
+
+struct State {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Stats>, std::less<>> stats;
+
+    std::mutex options_mutex;
+    Options options;
+    std::atomic<bool> writer_started {false};
+};
+
+// Never destroyed: engines may still record while the process exits
+State& state() {
+    static State* instance = new State;
+    return *instance;
+}
+
+constexpr uint64_t to_us(uint64_t ns) {
+    return ns / 1000;
+}
+
+void format_histogram(std::string& out, std::string_view name, const Histogram& histogram) {
+    if (histogram.count() == 0) {
+        return;
+    }
+    fmt::format_to(std::back_inserter(out), "{:<16} {:>8} {:>10.0f} {:>10} {:>10} {:>10} {:>10} {:>10}\n", name,
+                   histogram.count(), histogram.mean(), histogram.percentile(50), histogram.percentile(90),
+                   histogram.percentile(99), histogram.percentile(99.9), histogram.max());
+}
+
+void writer_main() {
+    auto& s = state();
+    uint64_t reported = 0;
+    for (;;) {
+        Options options;
+        {
+            std::lock_guard lock(s.options_mutex);
+            options = s.options;
+        }
+        std::this_thread::sleep_for(options.interval);
+
+        uint64_t count = total().total_us.count();
+        if (options.file.empty() || count == reported) {
+            continue;
+        }
+        if (dump(options.file)) {
+            reported = count;
+        }
+    }
+}
+
+} // namespace
+
+const char* metrics::to_string(Stage stage) {
+    static const char* names[] = {"connect", "request_sent", "first_byte", "first_audio", "last_byte"};
+    return stage < Stage::Count ? names[size_t(stage)] : "?";
+}
+
+void Utterance::start() noexcept {
+    start(trace::Clock::now());
+}
+
+void Utterance::start(uint64_t time) noexcept {
+    *this = {};
+    start_ = time;
+}
+
+void Utterance::mark(Stage stage) noexcept {
+    auto& time = times_[size_t(stage)];
+    if (time == 0) {
+        time = trace::Clock::now();
+    }
+}
+
+void Utterance::received(uint64_t bytes) noexcept {
+    uint64_t now = trace::Clock::now();
+    if (times_[size_t(Stage::FirstByte)] == 0) {
+        times_[size_t(Stage::FirstByte)] = now;
+    }
+    times_[size_t(Stage::LastByte)] = now;
+    received_ += bytes;
+}
+
+void Utterance::written(uint64_t bytes, uint64_t stall_ns) noexcept {
+    mark(Stage::FirstAudio);
+    written_ += bytes;
+    stall_ += stall_ns;
+    longest_write_ = std::max(longest_write_, stall_ns);
+}
+
+void Utterance::finish() noexcept {
+    end_ = trace::Clock::now();
+    heap_.stop();
+}
+
+void Stats::record(const Utterance& utterance, uint32_t bytes_per_sec) noexcept {
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (uint64_t elapsed = utterance.elapsed(Stage(i))) {
+            stages[i].record(to_us(elapsed));
+        }
+    }
+    total_us.record(to_us(utterance.duration()));
+    write_stall_us.record(to_us(utterance.write_stall()));
+    longest_write_us.record(to_us(utterance.longest_write()));
+    if (utterance.voice_load() != 0) {
+        voice_load_us.record(to_us(utterance.voice_load()));
+    }
+    bytes.record(utterance.bytes_written());
+    if constexpr (allocations::enabled) {
+        heap_allocations.record(utterance.heap().count());
+        heap_peak_bytes.record(utterance.heap().peak_bytes());
+    }
+
+    if (bytes_per_sec != 0 && utterance.bytes_written() != 0) {
+        double audio_ns = utterance.bytes_written() * 1e9 / bytes_per_sec;
+        real_time_factor.record(static_cast<uint64_t>(utterance.duration() * 1000.0 / audio_ns + 0.5));
+    }
+}
+
+Stats& metrics::stats(std::string_view name) {
+    auto& s = state();
+    std::lock_guard lock(s.mutex);
+
+    auto it = s.stats.find(name);
+    if (it == s.stats.end()) {
+        it = s.stats.emplace(std::string(name), std::make_unique<Stats>()).first;
+    }
+    return *it->second;
+}
+
+Stats& metrics::total() {
+    static Stats& stats = metrics::stats("total");
+    return stats;
+}
+
+std::string metrics::report() {
+    auto& s = state();
+    std::lock_guard lock(s.mutex);
+
+    std::string out = "# Times in microseconds from the start of Speak, real time factor in thousandths\n";
+    for (const auto& [name, stats] : s.stats) {
+        fmt::format_to(std::back_inserter(out), "\n[{}] {} utterances, {} aborted, {} failed\n", name,
+                       stats->total_us.count(), stats->aborted.load(std::memory_order_relaxed),
+                       stats->failed.load(std::memory_order_relaxed));
+        fmt::format_to(std::back_inserter(out), "{:<16} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "metric",
+                       "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+
+        for (size_t i = 0; i < stats->stages.size(); i++) {
+            format_histogram(out, to_string(Stage(i)), stats->stages[i]);
+        }
+        format_histogram(out, "total", stats->total_us);
+        format_histogram(out, "write_stall", stats->write_stall_us);
+        format_histogram(out, "longest_write", stats->longest_write_us);
+        format_histogram(out, "voice_load", stats->voice_load_us);
+        format_histogram(out, "real_time_factor", stats->real_time_factor);
+        format_histogram(out, "bytes", stats->bytes);
+        format_histogram(out, "heap_allocations", stats->heap_allocations);
+        format_histogram(out, "heap_peak_bytes", stats->heap_peak_bytes);
+    }
+    return out;
+}
+
+bool metrics::dump(const std::filesystem::path& file) {
+    // Written aside and renamed, so readers never see a partial report
+    auto temporary = file;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out << report();
+        if (!out) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, file, error);
+    return !error;
+}
+
+void metrics::start(const Options& options) {
+    auto& s = state();
+    {
+        std::lock_guard lock(s.options_mutex);
+        s.options = options;
+        if (s.options.interval.count() <= 0) {
+            s.options.interval = std::chrono::seconds(1);
+        }
+    }
+
+    if (!options.file.empty() && !s.writer_started.exchange(true)) {
+        std::thread(writer_main).detach();
+    }
+}
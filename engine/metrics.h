@@ -0,0 +1,129 @@
+#pragma once
+
+#include "allocations.h"
+#include "histogram.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Per-utterance latency breakdown. Engine::Speak fills in an Utterance with
+// the time of each stage, and records it into the Stats of its voice, of
+// its engine and of the whole process. Stats are lock-free histograms, so
+// recording never blocks a speaking thread. report() formats percentiles of
+// all of them, and start() has a background thread write that report to a
+// file periodically.
+namespace metrics {
+
+// Stages of an utterance, in the order they normally happen. For voices
+// spoken by VoiceServer, Connect is the pipe connection and RequestSent the
+// request written to it. For in-process voices, Connect is when the voice
+// object is ready and RequestSent when speak() has been called.
+enum class Stage { Connect, RequestSent, FirstByte, FirstAudio, LastByte, Count };
+
+const char* to_string(Stage stage);
+
+// Timeline of one Speak call, over all of its fragments. Times are
+// trace::Clock nanoseconds, zero for stages that did not happen.
+class Utterance {
+public:
+    void start() noexcept;
+
+    // Starts the timeline at an earlier `time`, such as when a request was
+    // due rather than when it got to run
+    void start(uint64_t time) noexcept;
+
+    // Records the first time `stage` is reached
+    void mark(Stage stage) noexcept;
+
+    // Audio arrived from the voice: sets FirstByte once, LastByte every time.
+    // May be called from another thread than the rest, which must then be
+    // synchronized with it before finish().
+    void received(uint64_t bytes) noexcept;
+
+    // `bytes` were written to the site, which blocked for `stall_ns`
+    void written(uint64_t bytes, uint64_t stall_ns) noexcept;
+
+    // The voice was still loading when the utterance started; loading it
+    // took `ns` in all, part of which shows in the Connect time
+    void voice_loaded(uint64_t ns) noexcept { voice_load_ = ns; }
+
+    void finish() noexcept;
+
+    uint64_t elapsed(Stage stage) const noexcept {
+        uint64_t time = times_[size_t(stage)];
+        return time ? time - start_ : 0;
+    }
+    uint64_t duration() const noexcept { return end_ - start_; }
+    uint64_t bytes_received() const noexcept { return received_; }
+    uint64_t bytes_written() const noexcept { return written_; }
+    uint64_t write_stall() const noexcept { return stall_; }
+    uint64_t longest_write() const noexcept { return longest_write_; }
+    uint64_t voice_load() const noexcept { return voice_load_; }
+
+    // Heap use of the thread that called start() and finish(), when
+    // allocation accounting is built in
+    const allocations::Scope& heap() const noexcept { return heap_; }
+
+private:
+    uint64_t start_ = 0;
+    uint64_t end_ = 0;
+    std::array<uint64_t, size_t(Stage::Count)> times_ {};
+    uint64_t received_ = 0;
+    uint64_t written_ = 0;
+    uint64_t stall_ = 0;
+    uint64_t longest_write_ = 0;
+    uint64_t voice_load_ = 0;
+    allocations::Scope heap_;
+};
+
+// Histograms of the utterances of one voice or engine. Times are in
+// microseconds from the start of Speak.
+struct Stats {
+    std::array<Histogram, size_t(Stage::Count)> stages;
+    Histogram total_us;
+    Histogram write_stall_us;
+    Histogram longest_write_us;
+    // Only recorded by utterances that waited for their voice to load
+    Histogram voice_load_us;
+    // Speak time over audio time, in thousandths
+    Histogram real_time_factor;
+    Histogram bytes;
+    // Only recorded with allocation accounting, see allocations.h
+    Histogram heap_allocations;
+    Histogram heap_peak_bytes;
+
+    std::atomic<uint64_t> aborted {0};
+    std::atomic<uint64_t> failed {0};
+
+    // `bytes_per_sec` is the output format's, 0 when unknown
+    void record(const Utterance& utterance, uint32_t bytes_per_sec) noexcept;
+};
+
+// Stats registered under `name`, created on first use. The reference stays
+// valid for the life of the process; look it up once, not per utterance.
+Stats& stats(std::string_view name);
+
+// Stats of every utterance in the process
+Stats& total();
+
+// Percentiles of every registered Stats, as text
+std::string report();
+
+// Writes report() to `file`, replacing it. Returns false on error.
+bool dump(const std::filesystem::path& file);
+
+struct Options {
+    // Report file, rewritten every `interval` while there are new
+    // utterances. Nothing is written when empty.
+    std::filesystem::path file;
+    std::chrono::seconds interval {10};
+};
+
+void start(const Options& options);
+
+} // namespace metrics
@@ -0,0 +1,96 @@
+#include "native_voice.h"
+#include "slog.h"
+
+#include <stdexcept>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace {
+
+void* open_library(const std::filesystem::path& path) {
+#if defined(_WIN32)
+    return LoadLibraryW(path.c_str());
+#else
+    return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+void* find_symbol(void* library, const char* name) {
+#if defined(_WIN32)
+    return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+    return dlsym(library, name);
+#endif
+}
+
+void close_library(void* library) {
+#if defined(_WIN32)
+    FreeLibrary(static_cast<HMODULE>(library));
+#else
+    dlclose(library);
+#endif
+}
+
+// Anything SAPI can take as a WAVEFORMATEX, with a nonzero block align
+bool valid_format(const pysapi_voice_format& format) {
+    auto bits = format.bits_per_sample;
+    return format.samples_per_sec != 0 && format.channels != 0 &&
+           (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+}
+
+} // namespace
+
+NativeVoice::NativeVoice(const std::filesystem::path& library, const std::string& config) {
+    library_ = open_library(library);
+    if (library_ == nullptr) {
+        throw std::runtime_error(fmt::format("Failed to load voice plugin {}", library.string()));
+    }
+
+    try {
+        auto entry = reinterpret_cast<pysapi_voice_plugin_entry>(find_symbol(library_, PYSAPI_VOICE_PLUGIN_ENTRY));
+        if (entry == nullptr) {
+            throw std::runtime_error(fmt::format("{} does not export " PYSAPI_VOICE_PLUGIN_ENTRY, library.string()));
+        }
+
+        plugin_ = entry();
+        // Later versions only append fields, which size tells apart
+        if (plugin_ == nullptr || plugin_->abi_version < 1 || plugin_->size < sizeof(pysapi_voice_plugin)) {
+            throw std::runtime_error(fmt::format("{} was built for another plugin ABI version", library.string()));
+        }
+
+        voice_ = plugin_->create(config.c_str());
+        if (voice_ == nullptr) {
+            throw_error("create failed");
+        }
+
+        plugin_->format(voice_, &format_);
+        if (!valid_format(format_)) {
+            plugin_->destroy(voice_);
+            throw std::runtime_error(fmt::format("{} reports an unsupported format: {} Hz, {} channels, {} bits",
+                                                 library.string(), format_.samples_per_sec, format_.channels,
+                                                 format_.bits_per_sample));
+        }
+    }
+    catch (...) {
+        close_library(library_);
+        throw;
+    }
+
+    slog("NativeVoice: {} Hz, {} channels, {} bits", format_.samples_per_sec, format_.channels,
+         format_.bits_per_sample);
+}
+
+NativeVoice::~NativeVoice() {
+    plugin_->destroy(voice_);
+    close_library(library_);
+}
+
+void NativeVoice::throw_error(std::string_view what) const {
+    const char* error = plugin_->error(voice_);
+    throw std::runtime_error(fmt::format("Voice plugin {}: {}", what, error ? error : "unknown error"));
+}
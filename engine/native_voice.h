@@ -0,0 +1,53 @@
+#pragma once
+
+#include "voice_plugin.h"
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Voice implemented by a native plugin, see voice_plugin.h. Unlike Python
+// voices it needs neither the GIL nor the voice registry: each instance owns
+// its own plugin voice.
+class NativeVoice {
+public:
+    // Loads the plugin library and creates a voice from `config`. Throws
+    // std::runtime_error if either fails.
+    NativeVoice(const std::filesystem::path& library, const std::string& config);
+    ~NativeVoice();
+
+    NativeVoice(const NativeVoice&) = delete;
+    NativeVoice& operator=(const NativeVoice&) = delete;
+
+    const pysapi_voice_format& format() const { return format_; }
+
+    // Streams the audio for `text` to `write`, a callable taking a
+    // std::span<const char> and returning false to stop. It must not throw.
+    // Throws std::runtime_error if the voice fails.
+    template <typename Write>
+    void speak(std::string_view text, Write&& write);
+
+private:
+    [[noreturn]] void throw_error(std::string_view what) const;
+
+    void* library_ = nullptr;
+    const pysapi_voice_plugin* plugin_ = nullptr;
+    pysapi_voice* voice_ = nullptr;
+    pysapi_voice_format format_ {};
+};
+
+template <typename Write>
+void NativeVoice::speak(std::string_view text, Write&& write) {
+    using WriteT = std::remove_reference_t<Write>;
+
+    auto trampoline = [](void* context, const void* data, size_t size) -> int {
+        auto& write = *static_cast<WriteT*>(context);
+        return write(std::span<const char>(static_cast<const char*>(data), size)) ? 0 : 1;
+    };
+
+    if (plugin_->speak(voice_, text.data(), text.size(), trampoline, &write) != 0) {
+        throw_error("speak failed");
+    }
+}
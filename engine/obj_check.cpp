@@ -0,0 +1,218 @@
+// Checks that pycpp::Obj and the helpers around it keep references
+// balanced: copies, moves, steal(), borrow(), assignment, reset(),
+// release(), swap(), the checked constructors when they throw, calls and
+// iteration. Each case runs many times against a fresh subject object,
+// whose refcount must be back to one afterwards. On a debug build of
+// Python, sys.gettotalrefcount() must also be unchanged, which catches
+// leaks and double releases of any other object a case touches.
+//
+// Exits with 1 if a case leaks or over-releases.
+
+#include "pycpp.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <fmt/format.h>
+
+namespace {
+
+struct Settings {
+    unsigned repetitions = 1000;
+};
+
+const char* usage = R"(Usage: obj_check [options]
+  --repetitions N    runs of each case (1000)
+)";
+
+struct Case {
+    const char* name;
+    // Gets a borrowed subject and must leave its refcount as it found it
+    std::function<void(PyObject* subject)> body;
+};
+
+const Case cases[] = {
+    {"copy construct", [](PyObject* subject) {
+        pycpp::Obj a {pycpp::borrowed_ref, subject};
+        pycpp::Obj b = a;
+        pycpp::Obj c {b};
+    }},
+    {"copy assign", [](PyObject* subject) {
+        pycpp::Obj a {pycpp::borrowed_ref, subject};
+        pycpp::Obj b {PyList_New(0)};
+        b = a;
+        auto& same = b;
+        b = same;
+        pycpp::Obj empty;
+        a = empty;
+    }},
+    {"move construct", [](PyObject* subject) {
+        pycpp::Obj a {pycpp::borrowed_ref, subject};
+        pycpp::Obj b = std::move(a);
+        pycpp::Obj c {std::move(b)};
+    }},
+    {"move assign", [](PyObject* subject) {
+        pycpp::Obj a {pycpp::borrowed_ref, subject};
+        pycpp::Obj b {PyList_New(0)};
+        b = std::move(a);
+        auto& same = b;
+        b = std::move(same);
+        a = std::move(b);
+    }},
+    {"steal", [](PyObject* subject) {
+        Py_INCREF(subject);
+        pycpp::Obj a = pycpp::Obj::steal(subject);
+        pycpp::Obj b = pycpp::Obj::steal(PyList_New(0));
+    }},
+    {"borrow", [](PyObject* subject) {
+        pycpp::Obj a = pycpp::Obj::borrow(subject);
+        pycpp::Obj b = pycpp::Obj::borrow(a);
+    }},
+    {"new and borrowed refs", [](PyObject* subject) {
+        pycpp::Obj a {pycpp::new_ref, pycpp::incref(subject)};
+        pycpp::Obj b {pycpp::borrowed_ref, subject};
+        pycpp::Obj c {PyLong_FromLong(1 << 20)};
+    }},
+    {"assign and reset", [](PyObject* subject) {
+        pycpp::Obj a;
+        a = pycpp::incref(subject);
+        a = PyList_New(0);
+        a.reset(subject);
+        a.reset(subject);
+        a.reset();
+        a.reset(subject);
+    }},
+    {"release and swap", [](PyObject* subject) {
+        pycpp::Obj a {pycpp::borrowed_ref, subject};
+        pycpp::Obj b = pycpp::Obj::steal(a.release());
+        pycpp::Obj c {PyList_New(0)};
+        b.swap(c);
+        c.swap(c);
+    }},
+    {"throwing constructors", [](PyObject* subject) {
+        pycpp::Obj a {pycpp::borrowed_ref, subject};
+        try {
+            pycpp::Obj b {PyObject_GetAttrString(subject, "no_such_attribute")};
+        }
+        catch (const pycpp::PythonException&) {
+        }
+        try {
+            a = PyObject_GetAttrString(subject, "no_such_attribute");
+        }
+        catch (const pycpp::PythonException&) {
+        }
+        if (a.ptr() != subject) {
+            throw std::logic_error("a failed assignment replaced the object");
+        }
+    }},
+    {"call and call_method", [](PyObject* subject) {
+        static pycpp::Name append {"append"};
+        static pycpp::Name pop {"pop"};
+        pycpp::Obj list {PyList_New(0)};
+        pycpp::Obj none = pycpp::call_method(list, append, subject);
+        pycpp::Obj popped = pycpp::call_method(list, pop);
+        pycpp::Obj copy = pycpp::call(reinterpret_cast<PyObject*>(&PyList_Type), list);
+    }},
+    {"iter_next", [](PyObject* subject) {
+        pycpp::Obj list {PyList_New(0)};
+        for (int i = 0; i < 3; i++) {
+            PyList_Append(list, subject);
+        }
+        pycpp::Obj iterator {PyObject_GetIter(list)};
+        while (pycpp::Obj item = pycpp::iter_next(iterator)) {
+        }
+    }},
+};
+
+// sys.gettotalrefcount, only present in debug builds of Python
+pycpp::Obj total_refcount_function() {
+    PyObject* sys = PyImport_AddModule("sys");
+    if (sys == nullptr || !PyObject_HasAttrString(sys, "gettotalrefcount")) {
+        PyErr_Clear();
+        return {};
+    }
+    return pycpp::Obj(PyObject_GetAttrString(sys, "gettotalrefcount"));
+}
+
+Py_ssize_t total_refcount(PyObject* function) {
+    pycpp::Obj total = pycpp::call(function);
+    return PyLong_AsSsize_t(total);
+}
+
+// Returns an empty string on success, what went wrong otherwise
+std::string run(const Case& check, unsigned repetitions, PyObject* gettotalrefcount) {
+    pycpp::Obj subject {PyList_New(0)};
+    // One run first, so lazily created objects such as interned names are
+    // not counted as leaks
+    check.body(subject);
+    Py_ssize_t total_before = gettotalrefcount ? total_refcount(gettotalrefcount) : 0;
+    for (unsigned i = 0; i < repetitions; i++) {
+        check.body(subject);
+    }
+    if (Py_REFCNT(subject.ptr()) != 1) {
+        return fmt::format("subject refcount {} instead of 1", Py_REFCNT(subject.ptr()));
+    }
+    if (gettotalrefcount) {
+        Py_ssize_t change = total_refcount(gettotalrefcount) - total_before;
+        if (change != 0) {
+            return fmt::format("total refcount changed by {} over {} runs", change, repetitions);
+        }
+    }
+    return "";
+}
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--repetitions" && has_value) {
+            settings.repetitions = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+    return settings;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    pycpp::PythonVM vm;
+    pycpp::ScopedGIL lock;
+    pycpp::Obj gettotalrefcount = total_refcount_function();
+    if (!gettotalrefcount) {
+        fmt::print("not a debug build of Python: checking subject refcounts only\n");
+    }
+
+    bool ok = true;
+    for (const auto& check : cases) {
+        std::string error;
+        try {
+            error = run(check, settings.repetitions, gettotalrefcount);
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+        fmt::print("{:<24}  {}\n", check.name, error.empty() ? "ok" : error);
+        ok &= error.empty();
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+// Checks the credit flow control of read_audio() against servers whose
+// chunks are smaller than a ring block, larger than one, and larger than
+// the whole window. The server spends partial credit, as the protocol in
+// pipe_client.h requires and VoiceServer and standin do. No case may
+// stall, and every byte must arrive in order.
+//
+// Exits with 1 if a case fails or does not finish within --timeout seconds.
+
+#include "pipe_client.h"
+#include "pipe_server.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Settings {
+    double timeout = 10;
+};
+
+const char* usage = R"(Usage: pipe_check [options]
+  --timeout S    seconds allowed per case (10)
+)";
+
+constexpr size_t block_size = 4096;
+constexpr size_t blocks = 4;
+constexpr size_t window = block_size * blocks;
+constexpr uint64_t total = 200 * 1000;
+
+char pattern(uint64_t offset) {
+    return static_cast<char>(offset * 131 % 251);
+}
+
+// Reads the request line, then credit, from what the client sends
+class Input {
+public:
+    explicit Input(PipeConnection& pipe) : pipe_(pipe) {}
+
+    bool skip_line() {
+        size_t end;
+        while ((end = buffer_.find('\n')) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        buffer_.erase(0, end + 1);
+        return true;
+    }
+
+    bool read_credit(uint64_t& credit) {
+        while (buffer_.size() < 4) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        auto byte = [&](size_t i) { return uint64_t(static_cast<unsigned char>(buffer_[i])) << (8 * i); };
+        credit += byte(0) | byte(1) | byte(2) | byte(3);
+        buffer_.erase(0, 4);
+        return true;
+    }
+
+private:
+    bool fill() {
+        char data[64];
+        ptrdiff_t size = pipe_.read(data);
+        if (size <= 0) {
+            return false;
+        }
+        buffer_.append(data, size);
+        return true;
+    }
+
+    PipeConnection& pipe_;
+    std::string buffer_;
+};
+
+void serve(PipeListener& listener, size_t chunk_size) {
+    PipeConnection pipe;
+    if (!listener.accept(pipe)) {
+        return;
+    }
+    Input input(pipe);
+    if (!input.skip_line()) {
+        return;
+    }
+
+    std::vector<char> chunk(chunk_size);
+    uint64_t credit = 0;
+    uint64_t sent = 0;
+    while (sent < total) {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(chunk_size, total - sent));
+        for (size_t i = 0; i < size; i++) {
+            chunk[i] = pattern(sent + i);
+        }
+        for (size_t offset = 0; offset < size;) {
+            while (sent == window + credit) {
+                if (!input.read_credit(credit)) {
+                    return;
+                }
+            }
+            size_t part = static_cast<size_t>(std::min<uint64_t>(size - offset, window + credit - sent));
+            if (!pipe.write(chunk.data() + offset, part)) {
+                return;
+            }
+            offset += part;
+            sent += part;
+        }
+    }
+    pipe.finish();
+}
+
+// Returns an empty string on success, what went wrong otherwise
+std::string run(size_t chunk_size, const std::string& name) {
+    PipeListener listener;
+    if (!listener.listen(name)) {
+        return "cannot listen";
+    }
+    std::thread server([&] { serve(listener, chunk_size); });
+
+    AudioRing ring(blocks, block_size);
+    metrics::Utterance utterance;
+    uint64_t received = 0;
+    bool in_order = true;
+    auto result = speak_through_pipe(name, {"check", "check", 1}, ring, utterance, [&](std::span<const char> block) {
+        for (char c : block) {
+            in_order &= c == pattern(received++);
+        }
+        return true;
+    });
+    server.join();
+
+    if (result != PipeSpeakResult::Ok) {
+        return fmt::format("result {}", static_cast<int>(result));
+    }
+    if (received != total) {
+        return fmt::format("{} of {} bytes", received, total);
+    }
+    return in_order ? "" : "bytes out of order";
+}
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--timeout" && has_value) {
+            settings.timeout = std::stod(argv[++i]);
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+    return settings;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    const size_t chunk_sizes[] = {1000, block_size, block_size + 1, 10000, window, window + 1, 70000};
+
+    bool ok = true;
+    unsigned number = 0;
+    for (size_t chunk_size : chunk_sizes) {
+#if defined(_WIN32)
+        auto name = fmt::format("pipe_check.{}.{}", _getpid(), number++);
+#else
+        auto name = fmt::format("/tmp/pipe_check.{}.{}.sock", getpid(), number++);
+#endif
+        // A stalled case never returns, so it runs on its own thread and
+        // the process exits without it
+        auto future = std::async(std::launch::async, [&] { return run(chunk_size, name); });
+        std::string error = future.wait_for(std::chrono::duration<double>(settings.timeout)) == std::future_status::ready
+                                ? future.get()
+                                : "stalled";
+        fmt::print("chunk {:>6}  {}\n", chunk_size, error.empty() ? "ok" : error);
+        std::fflush(stdout);
+        if (error == "stalled") {
+            std::_Exit(1);
+        }
+        ok &= error.empty();
+    }
+    return ok ? 0 : 1;
+}
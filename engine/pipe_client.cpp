@@ -0,0 +1,252 @@
+#include "pipe_client.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void append_json_string(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned>(c));
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+std::string pipe_path(std::string_view name) {
+    if (name.find('/') != std::string_view::npos) {
+        return std::string(name);
+    }
+    const char* directory = std::getenv("XDG_RUNTIME_DIR");
+    return fmt::format("{}/{}.sock", directory && *directory ? directory : "/tmp", name);
+}
+
+#if defined(_WIN32)
+
+bool PipeConnection::connect(std::string_view name) {
+    close();
+    auto path = fmt::format(R"(\\.\pipe\{})", name);
+    for (;;) {
+        HANDLE pipe = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            handle_ = pipe;
+            return true;
+        }
+        // Every instance is taken until the server creates the next one
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(path.c_str(), 1000)) {
+            return false;
+        }
+    }
+}
+
+void PipeConnection::close() {
+    if (handle_ != nullptr) {
+        CloseHandle(handle_);
+        handle_ = nullptr;
+    }
+}
+
+bool PipeConnection::write(const void* data, size_t size) {
+    DWORD bytes_written;
+    return WriteFile(handle_, data, (DWORD)size, &bytes_written, NULL) && bytes_written == size;
+}
+
+ptrdiff_t PipeConnection::read(std::span<char> buffer) {
+    for (;;) {
+        // A message larger than the buffer is delivered over several reads
+        // with ERROR_MORE_DATA
+        DWORD bytes_read = 0;
+        if (!ReadFile(handle_, buffer.data(), (DWORD)buffer.size(), &bytes_read, NULL)) {
+            DWORD error = GetLastError();
+            if (error == ERROR_BROKEN_PIPE) {
+                return 0;
+            }
+            if (error != ERROR_MORE_DATA) {
+                return -1;
+            }
+        }
+        // Empty messages are not the end of the stream
+        if (bytes_read > 0) {
+            return bytes_read;
+        }
+    }
+}
+
+void PipeConnection::cancel() {
+    CancelIoEx(handle_, NULL);
+}
+
+void PipeConnection::finish() {
+    FlushFileBuffers(handle_);
+}
+
+#else
+
+bool PipeConnection::connect(std::string_view name) {
+    close();
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    auto path = pipe_path(name);
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        return false;
+    }
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PipeConnection::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool PipeConnection::write(const void* data, size_t size) {
+    auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = send(fd_, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+ptrdiff_t PipeConnection::read(std::span<char> buffer) {
+    for (;;) {
+        ssize_t received = recv(fd_, buffer.data(), buffer.size(), 0);
+        if (received >= 0) {
+            return received;
+        }
+        // ECONNRESET included: a server that resets the connection has not
+        // ended the stream with finish(), so the audio may be cut short
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+void PipeConnection::cancel() {
+    shutdown(fd_, SHUT_RDWR);
+}
+
+void PipeConnection::finish() {
+    // The client closes once it has read the end of the stream. Closing
+    // first with credit still unread would reset the connection instead.
+    shutdown(fd_, SHUT_WR);
+    char discard[64];
+    while (read(discard) > 0) {
+    }
+}
+
+#endif
+
+void format_speak_request(const SpeakRequest& request, size_t window, std::string& out) {
+    // One line, so stream servers can frame it
+    out = R"({"action":"speak","text":)";
+    out.reserve(out.size() + request.text.size() + 128);
+    append_json_string(out, request.text);
+    out += R"(,"engine":)";
+    append_json_string(out, request.engine);
+    fmt::format_to(std::back_inserter(out), R"(,"window":{},"request_id":"{:016x}"}})", window, request.request_id);
+    out += '\n';
+}
+
+bool send_speak_request(PipeConnection& pipe, const SpeakRequest& request, size_t window) {
+    std::string message;
+    format_speak_request(request, window, message);
+    return pipe.write(message.data(), message.size());
+}
+
+bool send_credit(PipeConnection& pipe, uint32_t bytes) {
+    unsigned char message[4] = {
+        static_cast<unsigned char>(bytes),
+        static_cast<unsigned char>(bytes >> 8),
+        static_cast<unsigned char>(bytes >> 16),
+        static_cast<unsigned char>(bytes >> 24),
+    };
+    return pipe.write(message, sizeof(message));
+}
+
+// The flow control window is the ring capacity, so audio in flight plus
+// audio waiting in the ring never exceeds it. Credit is returned as the
+// consumer releases blocks. It has to be sent from this thread because the
+// Windows handle is synchronous and a write would queue behind a pending
+// read.
+//
+// The server closes its end as soon as it has sent the last byte, so
+// credit may well be refused at the end of a stream. That alone is not an
+// error: the next read tells whether the stream ended or broke.
+bool read_audio(PipeConnection& pipe, AudioRing& ring, metrics::Utterance& utterance, uint64_t request_id) {
+    bool ok = true;
+    bool can_grant = true;
+    uint64_t granted = ring.capacity();
+
+    for (;;) {
+        auto block = ring.acquire();
+        if (block.empty()) {
+            // Consumer cancelled
+            break;
+        }
+
+        // Everything the consumer has released is granted before blocking
+        // in read(), however little: the server may have spent all its
+        // credit and be waiting for this grant.
+        uint64_t grant = ring.released_bytes() + ring.capacity() - granted;
+        if (can_grant && grant > 0) {
+            TRACE_SPAN(trace::Level::Info, trace::Category::Pipe, "pipe.credit", request_id);
+            can_grant = send_credit(pipe, (uint32_t)grant);
+            granted += grant;
+        }
+
+        ptrdiff_t bytes_read;
+        {
+            TRACE_SPAN(trace::Level::Info, trace::Category::Pipe, "pipe.read", request_id);
+            bytes_read = pipe.read(block);
+        }
+        if (bytes_read <= 0) {
+            ok = bytes_read == 0;
+            break;
+        }
+
+        utterance.received(bytes_read);
+        ring.commit(bytes_read);
+    }
+
+    ring.close();
+    return ok;
+}
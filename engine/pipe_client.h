@@ -0,0 +1,158 @@
+#pragma once
+
+#include "audio_ring.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Client end of the VoiceServer speak protocol.
+//
+// A request is one line of compact JSON. The server answers with raw PCM
+// and closes its end after the last byte, once the client has read it (see
+// PipeConnection::finish()). A connection reset before that is an error,
+// not the end of the stream. It may send at most `window`
+// bytes more than the credit granted so far; credit is a 4-byte
+// little-endian byte count sent on the same connection. A server must
+// spend its credit down to zero before it waits for more, writing part of
+// a chunk if need be. Credit for audio released while the client is
+// blocked reading is only sent once that read returns, so a server that
+// waits for room for a whole chunk can stall both sides.
+//
+// On Windows the connection is the message mode named pipe \\.\pipe\<name>.
+// Elsewhere it is a Unix domain stream socket at pipe_path(name), so the
+// engine core and the load tools also run on Linux against a stand-in
+// server.
+
+inline constexpr const char* default_pipe_name = "AACSpeakHelper";
+
+// Socket path for `name` on POSIX systems: `name` itself if it contains a
+// '/', otherwise <name>.sock in $XDG_RUNTIME_DIR, or in /tmp
+std::string pipe_path(std::string_view name);
+
+class PipeConnection {
+public:
+    PipeConnection() = default;
+    ~PipeConnection() { close(); }
+
+    PipeConnection(const PipeConnection&) = delete;
+    PipeConnection& operator=(const PipeConnection&) = delete;
+
+    bool connect(std::string_view name);
+    void close();
+
+    // Writes all of `data` as one message
+    bool write(const void* data, size_t size);
+
+    // Reads up to buffer.size() bytes of what the server has sent. Returns
+    // the byte count, 0 once the server has closed its end, -1 on error.
+    ptrdiff_t read(std::span<char> buffer);
+
+    // Makes a read() blocked on another thread return
+    void cancel();
+
+    // Server side, before close(): tells the client no more is coming and
+    // returns once it has read everything written so far
+    void finish();
+
+private:
+    friend class PipeListener;
+
+#if defined(_WIN32)
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+struct SpeakRequest {
+    std::string_view text;
+    std::string_view engine;
+    uint64_t request_id = 0;
+};
+
+// Formats `request` as the one-line message send_speak_request() writes,
+// reusing the storage of `out`
+void format_speak_request(const SpeakRequest& request, size_t window, std::string& out);
+
+bool send_speak_request(PipeConnection& pipe, const SpeakRequest& request, size_t window);
+
+// Grants the server permission to send `bytes` more bytes of audio
+bool send_credit(PipeConnection& pipe, uint32_t bytes);
+
+// Runs on the reader thread: streams the response into `ring` until the
+// server closes its end of the pipe, granting credit as the consumer
+// releases blocks. Always closes the ring so the consumer wakes up, and
+// returns false if the stream ended with an error.
+bool read_audio(PipeConnection& pipe, AudioRing& ring, metrics::Utterance& utterance, uint64_t request_id);
+
+enum class PipeSpeakResult { Ok, ConnectFailed, SendFailed, ReadFailed, Stopped };
+
+// Speaks `request` through the server called `pipe_name`. Audio is read
+// into `ring` on a reader thread while this thread hands each block to
+// `write`, a callable taking a std::span<const char> and returning false
+// to stop. The stages of `utterance` are marked along the way.
+template <typename Write>
+PipeSpeakResult speak_through_pipe(std::string_view pipe_name, const SpeakRequest& request, AudioRing& ring,
+                                   metrics::Utterance& utterance, Write&& write) {
+    PipeConnection pipe;
+    bool ok;
+    {
+        TRACE_SPAN(trace::Level::Info, trace::Category::Pipe, "pipe.connect", request.request_id);
+        ok = pipe.connect(pipe_name);
+    }
+    if (!ok) {
+        return PipeSpeakResult::ConnectFailed;
+    }
+    utterance.mark(metrics::Stage::Connect);
+
+    {
+        TRACE_SPAN(trace::Level::Info, trace::Category::Pipe, "pipe.send_request", request.request_id);
+        ok = send_speak_request(pipe, request, ring.capacity());
+    }
+    if (!ok) {
+        return PipeSpeakResult::SendFailed;
+    }
+    utterance.mark(metrics::Stage::RequestSent);
+
+    // The reader thread keeps receiving audio while this thread is
+    // blocked writing, at playback speed in the engine
+    ring.reset();
+    bool read_ok = false;
+    std::thread reader([&] { read_ok = read_audio(pipe, ring, utterance, request.request_id); });
+
+    bool stopped = false;
+    for (;;) {
+        // Time spent here is audio the server has not delivered yet
+        std::span<const char> block;
+        {
+            TRACE_SPAN(trace::Level::Info, trace::Category::Audio, "ring.wait", request.request_id);
+            block = ring.front();
+        }
+        if (block.empty()) {
+            break;
+        }
+        if (!write(block)) {
+            stopped = true;
+            break;
+        }
+        ring.release();
+    }
+
+    if (stopped) {
+        // Unblock the reader whether it waits on the ring or the pipe
+        ring.cancel();
+        pipe.cancel();
+    }
+    reader.join();
+
+    if (stopped) {
+        return PipeSpeakResult::Stopped;
+    }
+    return read_ok ? PipeSpeakResult::Ok : PipeSpeakResult::ReadFailed;
+}
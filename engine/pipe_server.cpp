@@ -0,0 +1,109 @@
+#include "pipe_server.h"
+
+#include <cstring>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+bool PipeListener::create_instance() {
+    // Message mode like VoiceServer, buffers large enough for a window
+    HANDLE pipe = CreateNamedPipeA(path_.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
+                                   PIPE_UNLIMITED_INSTANCES, 1 << 20, 1 << 20, 0, NULL);
+    if (pipe == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    next_ = pipe;
+    return true;
+}
+
+bool PipeListener::listen(std::string_view name) {
+    close();
+    path_ = fmt::format(R"(\\.\pipe\{})", name);
+    return create_instance();
+}
+
+void PipeListener::close() {
+    if (next_ != nullptr) {
+        CloseHandle(next_);
+        next_ = nullptr;
+    }
+}
+
+bool PipeListener::accept(PipeConnection& connection) {
+    if (next_ == nullptr && !create_instance()) {
+        return false;
+    }
+    // A client may have connected between CreateNamedPipe and here
+    if (!ConnectNamedPipe(next_, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+        close();
+        return false;
+    }
+
+    connection.close();
+    connection.handle_ = next_;
+    next_ = nullptr;
+    create_instance();
+    return true;
+}
+
+#else
+
+bool PipeListener::listen(std::string_view name) {
+    close();
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    auto path = pipe_path(name);
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd_, 128) != 0) {
+        close();
+        return false;
+    }
+    path_ = std::move(path);
+    return true;
+}
+
+void PipeListener::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (!path_.empty()) {
+        unlink(path_.c_str());
+        path_.clear();
+    }
+}
+
+bool PipeListener::accept(PipeConnection& connection) {
+    for (;;) {
+        int fd = ::accept(fd_, nullptr, nullptr);
+        if (fd >= 0) {
+            connection.close();
+            connection.fd_ = fd;
+            return true;
+        }
+        if (errno != EINTR && errno != ECONNABORTED) {
+            return false;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "pipe_client.h"
+
+#include <string>
+#include <string_view>
+
+// Server end of the pipe transport in pipe_client.h, for stand-in servers
+// and tests. Each accepted connection is a PipeConnection like the
+// client's, so the same read(), write() and finish() apply.
+class PipeListener {
+public:
+    PipeListener() = default;
+    ~PipeListener() { close(); }
+
+    PipeListener(const PipeListener&) = delete;
+    PipeListener& operator=(const PipeListener&) = delete;
+
+    // Starts listening as the server called `name`, replacing a stale
+    // socket left behind by an earlier server
+    bool listen(std::string_view name);
+    void close();
+
+    // Waits for the next client
+    bool accept(PipeConnection& connection);
+
+private:
+    std::string path_;
+#if defined(_WIN32)
+    // Instance waiting for the next client, created ahead so that clients
+    // never find the name missing between two accepts
+    void* next_ = nullptr;
+    bool create_instance();
+#else
+    int fd_ = -1;
+#endif
+};
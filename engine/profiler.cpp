@@ -0,0 +1,250 @@
+#include "pycpp.h"
+#include "slog.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fmt/format.h>
+
+using namespace pycpp;
+
+std::atomic<bool> profiler::detail::active {false};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A thread inside a profiler::Scope
+struct Thread {
+    unsigned long ident;
+    std::string label;
+    std::atomic<bool> waiting {false};
+    // GIL wait not moved into the stacks yet
+    std::atomic<uint64_t> gil_wait_ns {0};
+};
+
+struct State {
+    profiler::Options options;
+
+    // Guards threads and stacks
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Thread>> threads;
+    // Collapsed stack to nanoseconds
+    std::unordered_map<std::string, uint64_t> stacks;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread sampler;
+};
+
+// Never destroyed, like the interpreter
+State& state() {
+    static State* instance = new State;
+    return *instance;
+}
+
+thread_local Thread* current_thread = nullptr;
+
+void move_gil_wait(State& s, Thread& thread) {
+    uint64_t ns = thread.gil_wait_ns.exchange(0, std::memory_order_relaxed);
+    if (ns != 0) {
+        s.stacks[thread.label + ";[gil wait]"] += ns;
+    }
+}
+
+// PyThreadState::thread_id is not part of the limited or stable API: the
+// field is CPython-internal and may move or change meaning between
+// versions, so this needs checking on every Python upgrade
+PyThreadState* find_thread_state(unsigned long ident) {
+    for (auto* tstate = PyInterpreterState_ThreadHead(PyInterpreterState_Main()); tstate != nullptr;
+         tstate = PyThreadState_Next(tstate)) {
+        if (tstate->thread_id == ident) {
+            return tstate;
+        }
+    }
+    return nullptr;
+}
+
+std::string frame_name(PyFrameObject* frame) {
+    PyCodeObject* code = PyFrame_GetCode(frame);
+    const char* file = PyUnicode_AsUTF8(code->co_filename);
+    const char* name = PyUnicode_AsUTF8(code->co_qualname);
+    if (file == nullptr || name == nullptr) {
+        PyErr_Clear();
+    }
+    std::string_view file_view = file ? file : "?";
+    file_view = file_view.substr(file_view.find_last_of("/\\") + 1);
+    std::string result = fmt::format("{}:{}", file_view, name ? name : "?");
+    Py_DECREF(code);
+    // Separates frames in the collapsed format
+    std::replace(result.begin(), result.end(), ';', ':');
+    return result;
+}
+
+// Appends the frames of `frame` and its callers, outermost first. Steals
+// the reference to `frame`.
+void append_stack(std::string& stack, PyFrameObject* frame, unsigned max_depth) {
+    std::vector<std::string> names;
+    while (frame != nullptr) {
+        names.push_back(frame_name(frame));
+        PyFrameObject* back = PyFrame_GetBack(frame);
+        Py_DECREF(frame);
+        frame = back;
+    }
+    auto outermost = names.rbegin();
+    auto end = names.size() > max_depth ? outermost + max_depth : names.rend();
+    for (auto it = outermost; it != end; ++it) {
+        stack += ';';
+        stack += *it;
+    }
+}
+
+void sample(State& s, uint64_t weight_ns) {
+    std::lock_guard lock(s.mutex);
+    for (auto& thread : s.threads) {
+        move_gil_wait(s, *thread);
+        // Accounted for by its GilWait
+        if (thread->waiting.load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        auto* tstate = find_thread_state(thread->ident);
+        PyFrameObject* frame = tstate ? PyThreadState_GetFrame(tstate) : nullptr;
+        std::string stack = thread->label;
+        if (frame == nullptr) {
+            stack += ";[outside python]";
+        } else {
+            append_stack(stack, frame, s.options.max_depth);
+        }
+        s.stacks[stack] += weight_ns;
+    }
+}
+
+void write(State& s) {
+    std::vector<std::pair<std::string, uint64_t>> stacks;
+    {
+        std::lock_guard lock(s.mutex);
+        stacks.assign(s.stacks.begin(), s.stacks.end());
+    }
+    std::sort(stacks.begin(), stacks.end());
+
+    std::ofstream out(s.options.file, std::ios::binary | std::ios::trunc);
+    for (const auto& [stack, ns] : stacks) {
+        if (ns >= 1000) {
+            out << stack << ' ' << ns / 1000 << '\n';
+        }
+    }
+    if (!out) {
+        slog(L"profiler: could not write {}", s.options.file.wstring());
+    }
+}
+
+void sampler_main(State& s) {
+    auto last = Clock::now();
+    auto next_write = last + s.options.write_interval;
+
+    std::unique_lock lock(s.wake_mutex);
+    while (!s.wake.wait_for(lock, s.options.interval, [&] { return s.stopping; })) {
+        lock.unlock();
+        {
+            ScopedGIL gil;
+            // Counted from the last sample, so time spent waiting for the GIL
+            // is not lost
+            auto now = Clock::now();
+            sample(s, std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count());
+            last = now;
+        }
+        if (last >= next_write) {
+            write(s);
+            next_write = last + s.options.write_interval;
+        }
+        lock.lock();
+    }
+}
+
+} // namespace
+
+void profiler::start(const Options& options) {
+    static std::once_flag once;
+    if (options.file.empty()) {
+        return;
+    }
+    std::call_once(once, [&] {
+        auto& s = state();
+        s.options = options;
+        detail::active.store(true, std::memory_order_relaxed);
+        s.sampler = std::thread(sampler_main, std::ref(s));
+        slog(L"profiler: every {}ms to {}", options.interval.count(), options.file.wstring());
+    });
+}
+
+void profiler::stop() {
+    auto& s = state();
+    if (!s.sampler.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard lock(s.wake_mutex);
+        s.stopping = true;
+    }
+    s.wake.notify_all();
+    s.sampler.join();
+    detail::active.store(false, std::memory_order_relaxed);
+    write(s);
+}
+
+void profiler::register_thread(std::string_view label) {
+    if (current_thread != nullptr) {
+        return;
+    }
+    auto thread = std::make_unique<Thread>(PyThread_get_thread_ident(), std::string(label));
+    current_thread = thread.get();
+
+    auto& s = state();
+    std::lock_guard lock(s.mutex);
+    s.threads.push_back(std::move(thread));
+}
+
+profiler::Scope::Scope(std::string_view label) {
+    if (!detail::active.load(std::memory_order_relaxed) || current_thread != nullptr) {
+        return;
+    }
+    auto thread = std::make_unique<Thread>(PyThread_get_thread_ident(), std::string(label));
+    current_thread = thread.get();
+    registered_ = true;
+
+    auto& s = state();
+    std::lock_guard lock(s.mutex);
+    s.threads.push_back(std::move(thread));
+}
+
+profiler::Scope::~Scope() {
+    if (!registered_) {
+        return;
+    }
+    auto& s = state();
+    std::lock_guard lock(s.mutex);
+    move_gil_wait(s, *current_thread);
+    std::erase_if(s.threads, [](const auto& thread) { return thread.get() == current_thread; });
+    current_thread = nullptr;
+}
+
+profiler::detail::GilWait::GilWait() noexcept {
+    if (current_thread != nullptr) {
+        current_thread->waiting.store(true, std::memory_order_relaxed);
+        start_ = Clock::now();
+    }
+}
+
+profiler::detail::GilWait::~GilWait() {
+    if (current_thread != nullptr) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+        current_thread->gil_wait_ns.fetch_add(ns, std::memory_order_relaxed);
+        current_thread->waiting.store(false, std::memory_order_relaxed);
+    }
+}
@@ -3,7 +3,10 @@
 
 #include <stdexcept>
 #include <fmt/printf.h>
+#include <mutex>
 #include <span>
+#include <thread>
+#include <unordered_set>
 
 using namespace pycpp;
 
@@ -23,11 +26,57 @@ PythonVM::PythonVM() {
     Py_InitializeEx(0);
 }
 #else
-PythonVM::PythonVM() {
+namespace {
+
+std::mutex startup_times_mutex;
+PythonVM::StartupTimes startup_times_;
+
+void record_startup_time(PythonVM::Clock::duration PythonVM::StartupTimes::*phase, PythonVM::Clock::time_point start) {
+    auto elapsed = PythonVM::Clock::now() - start;
+    std::lock_guard lock(startup_times_mutex);
+    startup_times_.*phase = elapsed;
+}
+
+// sys.path and the entries on it, guarded by the GIL. Never freed, as the
+// interpreter is never finalized.
+struct SearchPaths {
+    PyObject* list;
+    std::unordered_set<std::wstring> entries;
+};
+SearchPaths* search_paths_ = nullptr;
+
+void init_search_paths() {
+    search_paths_ = new SearchPaths {incref(PySys_GetObject("path")), {}};
+
+    Py_ssize_t size = PyList_Size(search_paths_->list);
+    for (Py_ssize_t i = 0; i < size; i++) {
+        PyObject* entry = PyList_GetItem(search_paths_->list, i);
+        if (!PyUnicode_Check(entry)) {
+            continue;
+        }
+        Py_ssize_t length = 0;
+        wchar_t* path = PyUnicode_AsWideCharString(entry, &length);
+        if (path == nullptr) {
+            throw_error();
+        }
+        search_paths_->entries.emplace(path, length);
+        PyMem_Free(path);
+    }
+}
+
+long long to_ms(PythonVM::Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+} // namespace
+
+PythonVM::PythonVM(const Options& options) {
     slog("PythonVM::PythonVM");
 
     // call once idiom
-    static auto _ = [this]() {
+    [[maybe_unused]] static auto _ = [this, &options]() {
+        auto start = Clock::now();
+
         // Initialize the pre-configuration structure
         PyPreConfig preconfig;
         PyPreConfig_InitIsolatedConfig(&preconfig);
@@ -39,6 +88,9 @@ PythonVM::PythonVM() {
             throw std::runtime_error("Failed to pre-initialize Python");
         }
 
+        record_startup_time(&StartupTimes::pre_initialize, start);
+        start = Clock::now();
+
         // Initialize the configuration structure
         PyConfig config;
         PyConfig_InitIsolatedConfig(&config);
@@ -56,6 +108,38 @@ PythonVM::PythonVM() {
         // Free the configuration structure (no longer needed)
         PyConfig_Clear(&config);
 
+        record_startup_time(&StartupTimes::initialize, start);
+        start = Clock::now();
+
+        // Since 3.11 the computed search path is only known after
+        // initialization, and PyConfig can only replace it, not extend it.
+        // So bundles are put in front of it here, before any other code gets
+        // to import, and the rest of the paths go after it.
+        init_search_paths();
+        if (!options.bundles.empty()) {
+            Py_ssize_t index = 0;
+            for (const auto& bundle : options.bundles) {
+                Obj bundle_obj {convert(bundle)};
+                if (PyList_Insert(search_paths_->list, index++, bundle_obj) != 0) {
+                    throw_error();
+                }
+                search_paths_->entries.insert(bundle);
+                slog(L"PythonVM bundle={}", bundle);
+            }
+        }
+
+        record_startup_time(&StartupTimes::register_bundles, start);
+        start = Clock::now();
+
+        add_search_paths(options.search_paths);
+
+        record_startup_time(&StartupTimes::register_search_paths, start);
+
+        auto times = startup_times();
+        slog("PythonVM startup: pre_initialize={}ms initialize={}ms register_bundles={}ms register_search_paths={}ms",
+             to_ms(times.pre_initialize), to_ms(times.initialize), to_ms(times.register_bundles),
+             to_ms(times.register_search_paths));
+
         thread_state_ = PyEval_SaveThread();
 
         return 0;
@@ -69,7 +153,130 @@ PythonVM::~PythonVM() {
     //Py_FinalizeEx();
 }
 
-#if 0
+void PythonVM::warm_up(Options options, std::vector<std::wstring> precompile, std::vector<std::string> modules) {
+    std::thread([options = std::move(options), precompile = std::move(precompile), modules = std::move(modules)] {
+        try {
+            PythonVM vm {options};
+
+            ScopedGIL lock;
+            if (!precompile.empty()) {
+                Obj compileall {PyImport_ImportModule("compileall")};
+                Obj compile_dir {PyObject_GetAttrString(compileall, "compile_dir")};
+                Obj py_compile {PyImport_ImportModule("py_compile")};
+                Obj modes {PyObject_GetAttrString(py_compile, "PycInvalidationMode")};
+                Obj checked_hash {PyObject_GetAttrString(modes, "CHECKED_HASH")};
+                // The result says whether everything compiled; there may be
+                // no console to print the errors to
+                Obj quiet {PyLong_FromLong(2)};
+                Obj kwargs {PyDict_New()};
+                if (PyDict_SetItemString(kwargs, "quiet", quiet) != 0 ||
+                    PyDict_SetItemString(kwargs, "invalidation_mode", checked_hash) != 0) {
+                    throw_error();
+                }
+
+                for (const auto& directory : precompile) {
+                    auto start = Clock::now();
+                    try {
+                        Obj directory_obj {convert(directory)};
+                        Obj args {PyTuple_Pack(1, directory_obj.ptr())};
+                        Obj ok {PyObject_Call(compile_dir, args, kwargs)};
+                        if (!PyObject_IsTrue(ok)) {
+                            // Typically a directory the process cannot write to
+                            slog(L"PythonVM precompile of {} left some files uncompiled", directory);
+                        }
+                    }
+                    catch (const PythonException& e) {
+                        slog(L"PythonVM precompile of {} failed", directory);
+                        slog("PythonVM precompile error: {}", e.what());
+                    }
+                    auto elapsed = Clock::now() - start;
+                    slog(L"PythonVM precompile {}={}ms", directory, to_ms(elapsed));
+
+                    std::lock_guard times_lock(startup_times_mutex);
+                    startup_times_.precompiles.emplace_back(directory, elapsed);
+                }
+            }
+
+            for (const auto& module : modules) {
+                auto start = Clock::now();
+                try {
+                    Obj module_obj {PyImport_ImportModule(module.c_str())};
+                }
+                catch (const PythonException& e) {
+                    slog("PythonVM warm up of {} failed: {}", module, e.what());
+                }
+                auto elapsed = Clock::now() - start;
+                slog("PythonVM warm up import {}={}ms", module, to_ms(elapsed));
+
+                std::lock_guard times_lock(startup_times_mutex);
+                startup_times_.imports.emplace_back(module, elapsed);
+            }
+        }
+        catch (const std::exception& e) {
+            slog("PythonVM warm up failed: {}", e.what());
+        }
+    }).detach();
+}
+
+PythonVM::StartupTimes PythonVM::startup_times() {
+    std::lock_guard lock(startup_times_mutex);
+    return startup_times_;
+}
+
+size_t PythonVM::add_search_paths(const std::vector<std::wstring>& paths) {
+    assert(search_paths_ != nullptr);
+
+    size_t added = 0;
+    for (const auto& path : paths) {
+        if (!search_paths_->entries.insert(path).second) {
+            continue;
+        }
+
+        Obj path_obj {convert(path)};
+        if (PyList_Append(search_paths_->list, path_obj) == -1) {
+            search_paths_->entries.erase(path);
+            throw_error();
+        }
+        slog(L"PythonVM search path={}", path);
+        added++;
+    }
+
+    return added;
+}
+
+EventLoop& PythonVM::event_loop() {
+    static std::atomic<EventLoop*> instance;
+    static std::once_flag once;
+
+    EventLoop* loop = instance.load(std::memory_order_acquire);
+    if (loop != nullptr) {
+        return *loop;
+    }
+
+    // Starting the loop runs Python code, which may switch threads. Wait for
+    // it without the GIL so another thread getting here cannot deadlock.
+    PyThreadState* thread_state = PyGILState_Check() ? PyEval_SaveThread() : nullptr;
+    try {
+        std::call_once(once, [] {
+            ScopedGIL lock;
+            instance.store(new EventLoop(), std::memory_order_release);
+        });
+    }
+    catch (...) {
+        if (thread_state != nullptr) {
+            PyEval_RestoreThread(thread_state);
+        }
+        throw;
+    }
+    if (thread_state != nullptr) {
+        PyEval_RestoreThread(thread_state);
+    }
+
+    return *instance.load(std::memory_order_acquire);
+}
+
+// PyErr_GetRaisedException is new in 3.12
+#if PY_VERSION_HEX < 0x030C0000
 ExceptionInfo pycpp::get_exception_info() {
     assert(PyErr_Occurred());
     ExceptionInfo info;
@@ -80,25 +287,19 @@ ExceptionInfo pycpp::get_exception_info() {
     // Fetch the exception info
     PyErr_Fetch(&ptype, &pvalue, &ptraceback);
 
-    // Normalize the exception (optional but recommended)
+    // Normalize the exception, so pvalue is an exception instance
     PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
 
-    // Get the string representation of the exception type
-    PyObject *ptype_str = PyObject_Str(ptype);
-    const char *type_str = PyUnicode_AsUTF8(ptype_str);
-
     // Get the string representation of the exception value
     PyObject *pvalue_str = PyObject_Str(pvalue);
-    const char *value_str = PyUnicode_AsUTF8(pvalue_str);
+    const char *value_str = pvalue_str ? PyUnicode_AsUTF8(pvalue_str) : nullptr;
 
-    info.type = type_str;
-    info.value = value_str;
+    info.value = value_str ? value_str : "";
 
     // Clean up
     Py_XDECREF(ptype);
     Py_XDECREF(pvalue);
     Py_XDECREF(ptraceback);
-    Py_XDECREF(ptype_str);
     Py_XDECREF(pvalue_str);
 
     // Clear the error indicator
@@ -133,31 +334,11 @@ void pycpp::throw_on_error() {
     }
 }
 
-bool pycpp::append_to_syspath(std::wstring_view path) {
-    Obj sys_module_obj {PyImport_ImportModule("sys")};
-    assert(PyModule_Check(sys_module_obj));
-
-    Obj path_list_obj {PyObject_GetAttrString(sys_module_obj, "path")};
-    assert(PyList_Check(path_list_obj));
+void pycpp::throw_error() {
+    throw_on_error();
 
-    Obj path_obj {convert(path)};
-
-    Py_ssize_t size = PyList_Size(path_list_obj);
-    slog("path_list_obj size: {}", size);
-
-    for (Py_ssize_t i = 0; i < size; i++) {
-        Obj path_i {incref(PyList_GetItem(path_list_obj, i))};
-        assert(PyUnicode_Check(path_i) == 1);
-        if (PyUnicode_Compare(path_obj, path_i) == 0) {
-            return false;
-        }
-    }
-
-    if (PyList_Append(path_list_obj, path_obj) == -1) {
-        throw PythonException("PyList_Append failed");
-    }
-
-    return true;
+    // Lookups such as PyDict_GetItemString return NULL without raising
+    throw PythonException("NULL result without an exception set");
 }
 
 PyObject* pycpp::convert(std::string_view value) {
@@ -178,3 +359,239 @@ PyObject* pycpp::bytes(std::span<const char> value) {
     return o;
 }
 
+Iter::Iter(Obj iterator, size_t max_batch, Clock::duration batch_budget)
+    : iterator_(std::move(iterator)),
+      max_batch_(max_batch),
+      batch_budget_(batch_budget) {
+    assert(max_batch_ > 0);
+    buffers_.reserve(max_batch_);
+    batch_.reserve(max_batch_);
+}
+
+Iter::~Iter() {
+    ScopedGIL lock;
+    buffers_.clear();
+    iterator_.reset();
+}
+
+Iter::iterator Iter::begin() {
+    fill();
+    return iterator(this);
+}
+
+void Iter::fill() {
+    ScopedGIL lock;
+
+    // The previous batch is consumed; let go of its exporters
+    buffers_.clear();
+    batch_.clear();
+
+    if (!iterator_) {
+        return;
+    }
+
+    while (batch_.size() < max_batch_) {
+        auto start = Clock::now();
+        Obj item = iter_next(iterator_);
+        auto pull_time = Clock::now() - start;
+
+        if (!item) {
+            iterator_.reset();
+            break;
+        }
+
+        const Buffer& buffer = buffers_.emplace_back(item);
+        batch_.push_back({buffer.span(), pull_time});
+
+        if (pull_time > batch_budget_) {
+            break;
+        }
+    }
+}
+
+namespace {
+
+const char* event_loop_source = R"(
+import asyncio
+
+loop = asyncio.new_event_loop()
+
+async def anext_or_none(aiter):
+    try:
+        return await anext(aiter)
+    except StopAsyncIteration:
+        return None
+
+def submit(coroutine, callback):
+    future = asyncio.run_coroutine_threadsafe(coroutine, loop)
+    future.add_done_callback(callback)
+    return future
+)";
+
+const char* future_capsule_name = "pycpp.FutureState";
+
+// Done callback of the concurrent future, called on the event loop thread
+// with the GIL held. self is a capsule owning a reference to the state.
+PyObject* on_future_done(PyObject* self, PyObject* future) {
+    static Name result_name {"result"};
+
+    auto& state = *static_cast<std::shared_ptr<detail::FutureState>*>(
+        PyCapsule_GetPointer(self, future_capsule_name));
+
+    PyObject* result = PyObject_CallMethodNoArgs(future, result_name.get());
+    if (state->abandoned) {
+        Py_XDECREF(result);
+        PyErr_Clear();
+    }
+    else if (result == nullptr) {
+        state->failed = true;
+        state->error = get_exception_info().value;
+    }
+    else {
+        state->result = result;
+    }
+
+    state->done.store(1, std::memory_order_release);
+    state->done.notify_all();
+
+    Py_RETURN_NONE;
+}
+
+PyMethodDef on_future_done_def = {"on_future_done", on_future_done, METH_O, nullptr};
+
+} // namespace
+
+EventLoop::EventLoop() {
+    slog("EventLoop::EventLoop");
+
+    Obj globals {PyDict_New()};
+    Obj builtins {borrowed_ref, PyEval_GetBuiltins()};
+    if (PyDict_SetItemString(globals, "__builtins__", builtins) != 0) {
+        throw_error();
+    }
+    Obj result {PyRun_String(event_loop_source, Py_file_input, globals, globals)};
+
+    loop_ = Obj(borrowed_ref, PyDict_GetItemString(globals, "loop"));
+    submit_ = Obj(borrowed_ref, PyDict_GetItemString(globals, "submit"));
+    anext_ = Obj(borrowed_ref, PyDict_GetItemString(globals, "anext_or_none"));
+
+    // The loop thread lives for the rest of the process, like the VM
+    std::thread([loop = loop_]() mutable {
+        static Name run_forever_name {"run_forever"};
+        // Async voices run here, and are sampled whenever profiling runs
+        profiler::register_thread("event_loop");
+        ScopedGIL lock;
+        Obj running_loop = std::move(loop);
+        try {
+            call_method(running_loop, run_forever_name);
+        }
+        catch (const PythonException& e) {
+            slog("EventLoop stopped: {}", e.what());
+        }
+    }).detach();
+}
+
+Future EventLoop::submit(PyObject* coroutine) {
+    Future future;
+    future.state_ = std::make_shared<detail::FutureState>();
+
+    Obj capsule {PyCapsule_New(
+        new std::shared_ptr<detail::FutureState>(future.state_), future_capsule_name,
+        [](PyObject* capsule) {
+            delete static_cast<std::shared_ptr<detail::FutureState>*>(
+                PyCapsule_GetPointer(capsule, future_capsule_name));
+        })};
+    Obj callback {PyCFunction_New(&on_future_done_def, capsule)};
+
+    future.future_ = call(submit_, coroutine, callback);
+    return future;
+}
+
+Future EventLoop::next(PyObject* async_iterator) {
+    Obj coroutine = call(anext_, async_iterator);
+    return submit(coroutine);
+}
+
+Future::~Future() {
+    if (!state_) {
+        return;
+    }
+
+    ScopedGIL lock;
+    if (!state_->done.load(std::memory_order_acquire)) {
+        static Name cancel_name {"cancel"};
+        // Not call_method: a destructor must not throw
+        PyObject* cancelled = PyObject_CallMethodNoArgs(future_, cancel_name.get());
+        if (cancelled == nullptr) {
+            slog("Future cancel failed: {}", get_exception_info().value);
+            PyErr_Clear();
+        }
+        Py_XDECREF(cancelled);
+    }
+    state_->abandoned = true;
+    Py_XDECREF(state_->result);
+    state_->result = nullptr;
+    future_.reset();
+}
+
+Future& Future::operator=(Future&& o) noexcept {
+    Future old(std::move(*this));
+    state_ = std::move(o.state_);
+    future_ = std::move(o.future_);
+    return *this;
+}
+
+Obj Future::get() {
+    assert(state_);
+    state_->done.wait(0, std::memory_order_acquire);
+
+    if (state_->failed) {
+        throw PythonException(std::move(state_->error));
+    }
+
+    return Obj::steal(std::exchange(state_->result, nullptr));
+}
+
+AsyncIter::AsyncIter(Obj async_iterator)
+    : iterator_(std::move(async_iterator)) {
+}
+
+AsyncIter::~AsyncIter() {
+    // Cancels a pending step before letting go of the iterator
+    pending_ = Future();
+
+    ScopedGIL lock;
+    buffer_.reset();
+    iterator_.reset();
+}
+
+AsyncIter::iterator AsyncIter::begin() {
+    {
+        ScopedGIL lock;
+        pending_ = PythonVM::event_loop().next(iterator_);
+    }
+    advance();
+    return iterator(this);
+}
+
+void AsyncIter::advance() {
+    auto start = Clock::now();
+    PyObject* item = pending_.get().release();
+    auto wait_time = Clock::now() - start;
+
+    ScopedGIL lock;
+    Obj item_obj = Obj::steal(item);
+
+    // The previous chunk is consumed; let go of its exporter
+    buffer_.reset();
+
+    if (item_obj.ptr() == Py_None) {
+        done_ = true;
+        return;
+    }
+
+    const Buffer& buffer = buffer_.emplace(item_obj);
+    chunk_ = {buffer.span(), wait_time};
+
+    pending_ = PythonVM::event_loop().next(iterator_);
+}
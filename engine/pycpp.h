@@ -1,93 +1,201 @@
 #pragma once
 
 #include <Python.h>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <span>
+#include <utility>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <vector>
 
 namespace pycpp {
 
 class Obj;
+class EventLoop;
 
+// Error checking comes in two flavours. throw_on_error() queries the
+// interpreter's error state and is meant for APIs that signal failure out of
+// band. check() only looks at a PyObject* result, which is NULL exactly when
+// the call failed, so the success path costs a single compare.
 void throw_on_error();
 
+[[noreturn]] void throw_error();
+
+inline PyObject* check(PyObject* o) {
+    if (o == nullptr) [[unlikely]] {
+        throw_error();
+    }
+    return o;
+}
+
 PyObject* convert(std::string_view value);
 PyObject* convert(std::wstring_view value);
 PyObject* bytes(std::span<const char> value);
 
 inline PyObject* incref(PyObject* o) {
-    throw_on_error();
-    assert(o);
-    Py_INCREF(o);
+    Py_INCREF(check(o));
     return o;
 }
 
-bool append_to_syspath(std::wstring_view path);
-
 class PythonVM {
 public:
-    PythonVM();
+    using Clock = std::chrono::steady_clock;
+
+    // Only the options of the first PythonVM in the process take effect
+    struct Options {
+        // zipimport archives of precompiled modules, put ahead of everything
+        // else on sys.path so imports skip the directory scans and compiles
+        std::vector<std::wstring> bundles;
+        // Appended after the computed search path at initialization
+        std::vector<std::wstring> search_paths;
+    };
+
+    struct StartupTimes {
+        Clock::duration pre_initialize {};
+        Clock::duration initialize {};
+        Clock::duration register_bundles {};
+        Clock::duration register_search_paths {};
+        // Directories compiled by warm_up(), in order
+        std::vector<std::pair<std::wstring, Clock::duration>> precompiles;
+        // Imports done by warm_up(), in order
+        std::vector<std::pair<std::string, Clock::duration>> imports;
+    };
+
+    explicit PythonVM(const Options& options = {});
     ~PythonVM();
+
+    // Starts the interpreter on a background thread, compiles the .py files
+    // under the `precompile` directories to .pyc and imports `modules`, so
+    // the first voice does not pay for them. The .pyc files carry a hash of
+    // their source, which every import checks, so they never go stale when
+    // sources are copied with new timestamps. Failures are logged and
+    // otherwise ignored; the voice will report them when it loads.
+    static void warm_up(Options options, std::vector<std::wstring> precompile, std::vector<std::string> modules);
+
+    static StartupTimes startup_times();
+
+    // Appends the entries of `paths` that are not on sys.path yet. Entries
+    // are remembered in a hash set seeded from sys.path at initialization,
+    // so each one costs a lookup instead of a scan of the list; changes made
+    // to sys.path from Python are not seen. Requires the GIL. Returns the
+    // number of entries added.
+    static size_t add_search_paths(const std::vector<std::wstring>& paths);
+
+    // asyncio event loop running on its own thread, started on first use.
+    // May be called with or without the GIL.
+    static EventLoop& event_loop();
 private:
     PyThreadState* thread_state_;
 };
 
+// Reference ownership tags for constructing an Obj. A New reference is
+// stolen, a Borrowed one gets its own reference added.
+struct New {};
+struct Borrowed {};
+
+inline constexpr New new_ref {};
+inline constexpr Borrowed borrowed_ref {};
+
+// Owning handle to a PyObject. Copies add a reference, moves transfer it
+// without touching the refcount, so containers of Obj only pay for
+// refcounting when objects are actually shared. Copying and destroying
+// require the GIL; moving does not.
+//
+// Constructors, operator= and reset(o) are checked: a NULL argument throws
+// the pending Python exception. steal() and borrow() are the unchecked
+// counterparts for results already known to be valid.
 class Obj {
 public:
-    Obj() : o_(nullptr) {}
+    Obj() noexcept : o_(nullptr) {}
 
     ~Obj() {
-        if (o_ != nullptr) {
-            decref();
-        }
+        decref();
     }
 
-    explicit Obj(PyObject* o) {
-        throw_on_error();
+    explicit Obj(PyObject* o) : Obj(new_ref, o) {}
+
+    Obj(New, PyObject* o) : o_(check(o)) {}
+
+    Obj(Borrowed, PyObject* o) : o_(incref(o)) {}
+
+    static Obj steal(PyObject* o) noexcept {
         assert(o);
-        o_ = o;
+        Obj obj;
+        obj.o_ = o;
+        return obj;
     }
 
-    Obj(const Obj& o) {
-        if (o != o_) {
-            decref();
-            o_ = o;
-        }
+    static Obj borrow(PyObject* o) noexcept {
+        assert(o);
+        Py_INCREF(o);
+        return steal(o);
     }
 
-    const Obj& operator=(PyObject* o) {
-        throw_on_error();
-        assert(o);
-        if (o != o_) {
+    Obj(const Obj& o) : o_(o.o_) {
+        Py_XINCREF(o_);
+    }
+
+    Obj(Obj&& o) noexcept : o_(o.o_) {
+        o.o_ = nullptr;
+    }
+
+    Obj& operator=(const Obj& o) {
+        // Take the new reference first in case o refers to the same object
+        Py_XINCREF(o.o_);
+        decref();
+        o_ = o.o_;
+        return *this;
+    }
+
+    Obj& operator=(Obj&& o) noexcept {
+        if (this != &o) {
             decref();
-            o_ = o;
+            o_ = o.o_;
+            o.o_ = nullptr;
         }
+        return *this;
+    }
 
+    // Takes ownership of a new reference
+    Obj& operator=(PyObject* o) {
+        check(o);
+        decref();
+        o_ = o;
         return *this;
     }
 
+    // Adds a reference to a borrowed object
     void reset(PyObject* o) {
-        throw_on_error();
-        assert(o);
+        check(o);
         if (o != o_) {
+            Py_INCREF(o);
             decref();
             o_ = o;
-            Py_XINCREF(o_);
         }
     }
 
-    PyObject* reset() {
-        throw_on_error();
+    void reset() {
         decref();
+        o_ = nullptr;
+    }
+
+    // Gives up ownership of the reference without touching the refcount
+    [[nodiscard]] PyObject* release() noexcept {
         PyObject* o = o_;
         o_ = nullptr;
         return o;
     }
 
-    void decref() {
-        assert(!o_ || (o_ && (Py_REFCNT(o_) > 0)));
-        Py_XDECREF(o_);
+    void swap(Obj& o) noexcept {
+        std::swap(o_, o.o_);
     }
 
     const char* type_name() const {
@@ -103,14 +211,144 @@ public:
         return o_;
     }
 
-    operator bool() {
+    explicit operator bool() const {
         return o_ != nullptr;
     }
 
 private:
+    void decref() {
+        assert(!o_ || (o_ && (Py_REFCNT(o_) > 0)));
+        Py_XDECREF(o_);
+    }
+
     PyObject* o_;
 };
 
+// Advances an iterator. Returns an empty Obj once it is exhausted; the error
+// state is only consulted when PyIter_Next comes back empty.
+inline Obj iter_next(PyObject* iterator) {
+    PyObject* item = PyIter_Next(iterator);
+    if (item == nullptr) [[unlikely]] {
+        throw_on_error();
+        return Obj();
+    }
+    return Obj::steal(item);
+}
+
+// Attribute or method name interned on first use and kept for the life of
+// the process, so lookups never build a temporary str. Declare instances
+// static and only use them with the GIL held.
+class Name {
+public:
+    explicit constexpr Name(const char* name) : name_(name) {}
+
+    PyObject* get() {
+        if (o_ == nullptr) [[unlikely]] {
+            o_ = check(PyUnicode_InternFromString(name_));
+        }
+        return o_;
+    }
+
+private:
+    const char* name_;
+    PyObject* o_ = nullptr;
+};
+
+inline Obj getattr(PyObject* o, Name& name) {
+    return Obj(new_ref, PyObject_GetAttr(o, name.get()));
+}
+
+// Calls through the vectorcall protocol. Arguments are anything convertible
+// to PyObject* (including Obj) and are packed into a stack array at compile
+// time; no argument tuple is created. The spare slot in front lets the
+// callee prepend self without copying.
+template <typename... Args>
+Obj call(PyObject* callable, Args&&... args) {
+    PyObject* argv[] = {nullptr, static_cast<PyObject*>(args)...};
+    return Obj(new_ref, PyObject_Vectorcall(
+        callable, argv + 1, sizeof...(Args) | PY_VECTORCALL_ARGUMENTS_OFFSET, nullptr));
+}
+
+// Calls self.name(args...) without materializing a bound method
+template <typename... Args>
+Obj call_method(PyObject* self, Name& name, Args&&... args) {
+    PyObject* argv[] = {self, static_cast<PyObject*>(args)...};
+    return Obj(new_ref, PyObject_VectorcallMethod(
+        name.get(), argv, (sizeof...(Args) + 1) | PY_VECTORCALL_ARGUMENTS_OFFSET, nullptr));
+}
+
+// Read-only view of an object exporting the buffer protocol (bytes,
+// bytearray, memoryview, ...). The exporter is pinned while the Buffer is
+// alive: the memory stays valid and can be read without holding the GIL,
+// but constructing and destroying the Buffer require the GIL.
+class Buffer {
+public:
+    explicit Buffer(PyObject* o) {
+        if (PyObject_GetBuffer(o, &view_, PyBUF_SIMPLE) != 0) {
+            throw_error();
+        }
+    }
+
+    ~Buffer() {
+        PyBuffer_Release(&view_);
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    Buffer(Buffer&& o) noexcept : view_(o.view_) {
+        // PyBuffer_Release ignores a view without an exporter
+        o.view_.obj = nullptr;
+    }
+
+    std::span<const std::byte> span() const {
+        return {static_cast<const std::byte*>(view_.buf), static_cast<size_t>(view_.len)};
+    }
+
+    const void* data() const {
+        return view_.buf;
+    }
+
+    size_t size() const {
+        return static_cast<size_t>(view_.len);
+    }
+
+private:
+    Py_buffer view_;
+};
+
+// Lends C++-owned memory to Python as a read-only memoryview without copying.
+// The view is released on destruction so Python code that kept a reference
+// gets a ValueError instead of reading freed memory. Callees that need the
+// data past the call must copy it. Requires the GIL.
+class MemoryView {
+public:
+    explicit MemoryView(std::span<const std::byte> data)
+        : view_(new_ref, PyMemoryView_FromMemory(
+              const_cast<char*>(reinterpret_cast<const char*>(data.data())),
+              static_cast<Py_ssize_t>(data.size()), PyBUF_READ)) {}
+
+    ~MemoryView() {
+        static Name release_name {"release"};
+        PyObject* result = PyObject_CallMethodNoArgs(view_, release_name.get());
+        if (result == nullptr) {
+            // Slices of the view still export it; nothing more can be done
+            PyErr_Clear();
+        }
+        Py_XDECREF(result);
+    }
+
+    MemoryView(const MemoryView&) = delete;
+    MemoryView& operator=(const MemoryView&) = delete;
+
+    operator PyObject*() const {
+        return view_;
+    }
+
+private:
+    Obj view_;
+};
+
 struct ExceptionInfo {
     // std::string type;
     std::string value;
@@ -143,12 +381,84 @@ private:
     const ExceptionInfo info_;
 };
 
+// Opt-in sampling profiler for the Python code run by voices. While it
+// runs, a background thread takes the GIL every `interval` and records the
+// Python stack of each thread inside a profiler::Scope, weighted by the time
+// since the previous sample. Time such a thread spends in ScopedGIL waiting
+// for the GIL is recorded as a "[gil wait]" frame, and time it spends
+// outside Python (writing audio, waiting on a pipe) as "[outside python]".
+// The stacks are written in the collapsed format of flamegraph.pl and
+// speedscope, values in microseconds.
+namespace profiler {
+
+struct Options {
+    // Rewritten every `write_interval` with everything collected so far
+    std::filesystem::path file;
+    std::chrono::milliseconds interval {10};
+    std::chrono::seconds write_interval {10};
+    // Innermost frames beyond it are left out
+    unsigned max_depth = 64;
+};
+
+// Starts the sampler thread, once. The interpreter must be initialized.
+void start(const Options& options);
+
+// Writes the file and stops sampling
+void stop();
+
+// Puts the calling thread under `label` for the rest of its life, for a
+// thread that lives as long as the process, such as the event loop's.
+// Unlike a Scope it takes effect whenever profiling runs, including when
+// start() is only called later.
+void register_thread(std::string_view label);
+
+// Puts the calling thread under `label`, such as the voice it speaks for,
+// while profiling. An inner Scope on the same thread, or a Scope on a
+// registered thread, does nothing.
+class Scope {
+public:
+    explicit Scope(std::string_view label);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    bool registered_ = false;
+};
+
+namespace detail {
+
+extern std::atomic<bool> active;
+
+// Times a wait for the GIL of the calling thread
+class GilWait {
+public:
+    GilWait() noexcept;
+    ~GilWait();
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace detail
+
+} // namespace profiler
+
 class ScopedGIL
 {
 public:
     ScopedGIL()
     {
-        state_ = PyGILState_Ensure();
+        if (profiler::detail::active.load(std::memory_order_relaxed)) [[unlikely]]
+        {
+            profiler::detail::GilWait wait;
+            state_ = PyGILState_Ensure();
+        }
+        else
+        {
+            state_ = PyGILState_Ensure();
+        }
     }
 
     ~ScopedGIL()
@@ -160,4 +470,228 @@ private:
     PyGILState_STATE state_;
 };
 
+// Range over a Python iterator yielding buffer-like chunks (e.g. the
+// generator returned by a voice's speak()). Chunks are pulled in batches:
+// one GIL acquisition runs PyIter_Next up to max_batch times, and the GIL is
+// released while the caller processes the batch. A pull slower than
+// batch_budget ends the batch early so a slow (network bound) generator does
+// not hold back chunks it already produced.
+//
+// Iterate without holding the GIL; the range takes it as needed, including
+// in the destructor.
+class Iter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Chunk {
+        std::span<const std::byte> data;
+        // Time spent inside PyIter_Next producing this chunk
+        Clock::duration pull_time;
+    };
+
+    class iterator {
+    public:
+        using value_type = Chunk;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(Iter* range) : range_(range) {}
+
+        const Chunk& operator*() const {
+            return range_->batch_[index_];
+        }
+
+        const Chunk* operator->() const {
+            return &range_->batch_[index_];
+        }
+
+        iterator& operator++() {
+            if (++index_ == range_->batch_.size()) {
+                range_->fill();
+                index_ = 0;
+            }
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return index_ == range_->batch_.size();
+        }
+
+    private:
+        Iter* range_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    explicit Iter(Obj iterator, size_t max_batch = 16,
+                  Clock::duration batch_budget = std::chrono::microseconds(500));
+    ~Iter();
+
+    Iter(const Iter&) = delete;
+    Iter& operator=(const Iter&) = delete;
+
+    // Single pass: begin() may only be called once
+    iterator begin();
+
+    std::default_sentinel_t end() const {
+        return std::default_sentinel;
+    }
+
+private:
+    void fill();
+
+    Obj iterator_;
+    const size_t max_batch_;
+    const Clock::duration batch_budget_;
+    std::vector<Buffer> buffers_;
+    std::vector<Chunk> batch_;
+};
+
+namespace detail {
+
+// Completion state shared between a Future and the done callback running on
+// the event loop thread
+struct FutureState {
+    std::atomic<uint32_t> done {0};
+    PyObject* result = nullptr;
+    // Set with error when the coroutine raised, whose message may be empty
+    bool failed = false;
+    std::string error;
+    // Set when the Future is gone and the result has nobody to go to.
+    // Guarded by the GIL, as is result before done is set.
+    bool abandoned = false;
+};
+
+} // namespace detail
+
+// Result of a coroutine scheduled on the event loop. Destroying a Future
+// that has not completed cancels the coroutine.
+class Future {
+public:
+    Future() = default;
+    ~Future();
+
+    Future(Future&& o) noexcept = default;
+    Future& operator=(Future&& o) noexcept;
+
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    bool ready() const {
+        return state_ && state_->done.load(std::memory_order_acquire);
+    }
+
+    // Blocks until the coroutine finishes and returns its result, or throws
+    // its exception as PythonException. Must be called without the GIL so
+    // the event loop can make progress. Can only be called once.
+    Obj get();
+
+private:
+    friend class EventLoop;
+
+    std::shared_ptr<detail::FutureState> state_;
+    // The concurrent.futures.Future, kept for cancellation
+    Obj future_;
+};
+
+// A single asyncio event loop on a dedicated thread. Coroutines from any
+// number of concurrent utterances are multiplexed onto it, so async voices
+// do not tie up an OS thread per request. Obtain it via
+// PythonVM::event_loop(). submit() and next() require the GIL.
+class EventLoop {
+public:
+    EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Schedules a coroutine object
+    Future submit(PyObject* coroutine);
+
+    // Schedules one step of an async iterator. The Future resolves to the
+    // next item, or None once the iterator is exhausted.
+    Future next(PyObject* async_iterator);
+
+private:
+    Obj loop_;
+    Obj submit_;
+    Obj anext_;
+};
+
+// Range over an async iterator yielding buffer-like chunks, e.g. the async
+// generator returned by an asyncio-based voice's speak(). The next chunk is
+// requested from the event loop as soon as the current one is handed out,
+// so producing it overlaps with consuming this one.
+//
+// Iterate without holding the GIL; the range takes it as needed, including
+// in the destructor.
+class AsyncIter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Chunk {
+        std::span<const std::byte> data;
+        // Time the consumer was blocked waiting for this chunk
+        Clock::duration wait_time;
+    };
+
+    class iterator {
+    public:
+        using value_type = Chunk;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(AsyncIter* range) : range_(range) {}
+
+        const Chunk& operator*() const {
+            return range_->chunk_;
+        }
+
+        const Chunk* operator->() const {
+            return &range_->chunk_;
+        }
+
+        iterator& operator++() {
+            range_->advance();
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return range_->done_;
+        }
+
+    private:
+        AsyncIter* range_ = nullptr;
+    };
+
+    explicit AsyncIter(Obj async_iterator);
+    ~AsyncIter();
+
+    AsyncIter(const AsyncIter&) = delete;
+    AsyncIter& operator=(const AsyncIter&) = delete;
+
+    // Single pass: begin() may only be called once
+    iterator begin();
+
+    std::default_sentinel_t end() const {
+        return std::default_sentinel;
+    }
+
+private:
+    void advance();
+
+    Obj iterator_;
+    Future pending_;
+    std::optional<Buffer> buffer_;
+    Chunk chunk_ {};
+    bool done_ = false;
+};
+
 } // namespace pycpp
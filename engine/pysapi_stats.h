@@ -0,0 +1,65 @@
+#pragma once
+
+// Stable C view of the engine's live counters, for operators and tools.
+//
+// Every process using the engine publishes its counters in a shared memory
+// block, so they can be read from outside (see pysapistat) without
+// attaching a debugger. Writers update them with relaxed atomic adds and
+// readers copy them with atomic loads: reading never takes a lock and
+// never slows the audio path down. In-process clients can also call
+// pysapi_get_stats(), or IPySAPIStats::GetStats on the engine object.
+//
+// New fields are only ever appended, and `size` tells readers how many the
+// writer has.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PYSAPI_STATS_VERSION 1
+
+// Name of the shared memory block of process <pid>: a file mapping called
+// Local\PySAPITTSEngine.Stats.<pid> on Windows, /pysapi-stats.<pid> for
+// shm_open elsewhere
+#define PYSAPI_STATS_WINDOWS_PREFIX "Local\\PySAPITTSEngine.Stats."
+#define PYSAPI_STATS_POSIX_PREFIX "/pysapi-stats."
+
+// X(name, kind, description). Gauges go up and down, counters only grow.
+#define PYSAPI_STATS_FIELDS(X)                                                      \
+    X(active_streams, gauge, "Speak calls in progress")                            \
+    X(waiting_for_voice, gauge, "Speak calls waiting for their voice to load")     \
+    X(voices_loading, gauge, "Python voices queued or loading")                    \
+    X(utterances, counter, "Speak calls completed")                                \
+    X(aborted, counter, "Speak calls aborted by SAPI")                             \
+    X(bytes_streamed, counter, "audio bytes written to SAPI")                      \
+    X(voice_cache_hits, counter, "voices found in the voice registry")             \
+    X(voice_cache_misses, counter, "voices the registry had to load")              \
+    X(errors_connect, counter, "pipe server connections that failed")              \
+    X(errors_send, counter, "requests that could not be sent to the pipe server")  \
+    X(errors_read, counter, "pipe server streams that broke")                      \
+    X(errors_voice, counter, "Python voice exceptions")                            \
+    X(errors_plugin, counter, "native voice failures")                             \
+    X(errors_write, counter, "audio writes SAPI refused")
+
+typedef struct pysapi_stats {
+    // sizeof(pysapi_stats) and PYSAPI_STATS_VERSION as the writer was built
+    uint64_t size;
+    uint64_t version;
+    // Process the counters belong to
+    uint64_t pid;
+
+#define PYSAPI_STATS_DECLARE(name, kind, description) uint64_t name;
+    PYSAPI_STATS_FIELDS(PYSAPI_STATS_DECLARE)
+#undef PYSAPI_STATS_DECLARE
+} pysapi_stats;
+
+// Copies the counters of the calling process into `stats`, at most `size`
+// bytes of them. Returns the number of bytes written.
+size_t pysapi_get_stats(pysapi_stats* stats, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
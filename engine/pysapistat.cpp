@@ -0,0 +1,148 @@
+// Prints the live counters of processes using the engine, see
+// pysapi_stats.h. Reads them from shared memory, so the processes are not
+// disturbed and no debugger is needed.
+//
+//   pysapistat                  every process, once
+//   pysapistat --pid 1234 --watch 1
+//                               one process every second, with rates
+
+#include "live_stats.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+namespace {
+
+struct Settings {
+    uint64_t pid = 0;
+    double watch = 0;
+    bool json = false;
+};
+
+const char* usage = R"(Usage: pysapistat [options]
+  --pid N        only this process
+  --watch S      print again every S seconds, with rates
+  --json         print one JSON object per process and sample
+)";
+
+struct Field {
+    const char* name;
+    bool counter;
+    const char* description;
+    uint64_t pysapi_stats::*member;
+};
+
+const Field fields[] = {
+#define PYSAPI_STATS_ENTRY(name, kind, description) \
+    {#name, std::string_view(#kind) == "counter", description, &pysapi_stats::name},
+    PYSAPI_STATS_FIELDS(PYSAPI_STATS_ENTRY)
+#undef PYSAPI_STATS_ENTRY
+};
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--pid" && has_value) {
+            settings.pid = std::stoull(argv[++i]);
+        } else if (arg == "--watch" && has_value) {
+            settings.watch = std::stod(argv[++i]);
+        } else if (arg == "--json") {
+            settings.json = true;
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+    return settings;
+}
+
+double hit_rate(const pysapi_stats& stats) {
+    uint64_t lookups = stats.voice_cache_hits + stats.voice_cache_misses;
+    return lookups ? 100.0 * stats.voice_cache_hits / lookups : 0;
+}
+
+// `previous` is the sample `seconds` ago, or null for the first one
+void print(const pysapi_stats& stats, const pysapi_stats* previous, double seconds, bool json) {
+    if (json) {
+        std::string out = fmt::format(R"({{"pid":{},"version":{})", stats.pid, stats.version);
+        for (const auto& field : fields) {
+            fmt::format_to(std::back_inserter(out), R"(,"{}":{})", field.name, stats.*field.member);
+        }
+        fmt::format_to(std::back_inserter(out), R"(,"voice_cache_hit_rate":{:.1f}}})", hit_rate(stats));
+        fmt::print("{}\n", out);
+        return;
+    }
+
+    fmt::print("process {}\n", stats.pid);
+    for (const auto& field : fields) {
+        uint64_t value = stats.*field.member;
+        fmt::print("  {:<20} {:>14}", field.name, value);
+        if (previous && field.counter) {
+            fmt::print(" {:>12.1f}/s", (value - (*previous).*field.member) / seconds);
+        } else {
+            fmt::print(" {:>14}", "");
+        }
+        fmt::print("  {}\n", field.description);
+    }
+    fmt::print("  {:<20} {:>13.1f}%\n", "voice_cache_hit_rate", hit_rate(stats));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    std::map<uint64_t, pysapi_stats> previous;
+    auto last = std::chrono::steady_clock::now();
+    for (;;) {
+        auto pids = settings.pid ? std::vector<uint64_t> {settings.pid} : live_stats::published();
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        size_t found = 0;
+        for (uint64_t pid : pids) {
+            pysapi_stats stats;
+            if (!live_stats::read(pid, stats)) {
+                continue;
+            }
+            auto it = previous.find(pid);
+            print(stats, it != previous.end() ? &it->second : nullptr, seconds, settings.json);
+            previous[pid] = stats;
+            found++;
+        }
+        if (found == 0 && !settings.json) {
+            if (settings.pid) {
+                fmt::print("process {} has no engine counters\n", settings.pid);
+            } else {
+                fmt::print("no process has engine counters\n");
+            }
+        }
+        std::fflush(stdout);
+
+        if (settings.watch <= 0) {
+            return found ? 0 : 1;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(settings.watch));
+    }
+}
@@ -39,6 +39,8 @@ int wmain(int argc, wchar_t* argv[]) {
     const wchar_t* path = nullptr;
     const wchar_t* mod = nullptr;
     const wchar_t* cls = nullptr;
+    const wchar_t* plugin = nullptr;
+    const wchar_t* config = nullptr;
 
 
     for (int i = 1; i < argc; i++) {
@@ -69,6 +71,12 @@ int wmain(int argc, wchar_t* argv[]) {
         else if (std::wstring_view(argv[i]) == L"--class" && (i < argc - 1)) {
             cls = argv[++i];
         }
+        else if (std::wstring_view(argv[i]) == L"--plugin" && (i < argc - 1)) {
+            plugin = argv[++i];
+        }
+        else if (std::wstring_view(argv[i]) == L"--config" && (i < argc - 1)) {
+            config = argv[++i];
+        }
     }
 
     if (!check_arg(token_name, "token")) return 1;
@@ -77,9 +85,13 @@ int wmain(int argc, wchar_t* argv[]) {
     if (!check_arg(language, "language")) return 1;
     if (!check_arg(age, "age")) return 1;
     if (!check_arg(vendor, "vendor")) return 1;
-    if (!check_arg(path, "path")) return 1;
-    if (!check_arg(mod, "module")) return 1;
-    if (!check_arg(cls, "class")) return 1;
+
+    // Native plugin voices need no Python module
+    if (!plugin) {
+        if (!check_arg(path, "path")) return 1;
+        if (!check_arg(mod, "module")) return 1;
+        if (!check_arg(cls, "class")) return 1;
+    }
 
     int langid = std::stoi(language, nullptr, 16);
 
@@ -106,9 +118,17 @@ int wmain(int argc, wchar_t* argv[]) {
         expect(data_key->SetStringValue(L"Age", age), "SetStringValue for Age failed");
         expect(data_key->SetStringValue(L"Vendor", vendor), "SetStringValue for Vendor failed");
         
-        expect(token->SetStringValue(L"Path", path), "SetStringValue for Path failed");
-        expect(token->SetStringValue(L"Module", mod), "SetStringValue for Module failed");
-        expect(token->SetStringValue(L"Class", cls), "SetStringValue for Class failed");
+        if (plugin) {
+            expect(token->SetStringValue(L"Plugin", plugin), "SetStringValue for Plugin failed");
+            if (config) {
+                expect(token->SetStringValue(L"PluginConfig", config), "SetStringValue for PluginConfig failed");
+            }
+        }
+        else {
+            expect(token->SetStringValue(L"Path", path), "SetStringValue for Path failed");
+            expect(token->SetStringValue(L"Module", mod), "SetStringValue for Module failed");
+            expect(token->SetStringValue(L"Class", cls), "SetStringValue for Class failed");
+        }
     }
     catch (const std::runtime_error& e) {
         fmt::println("ERROR: {}", e.what());
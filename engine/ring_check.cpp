@@ -0,0 +1,174 @@
+// Stresses AudioRing with a producer and a consumer thread over random ring
+// shapes, block fills and consumer speeds. Each round the consumer either
+// drains the stream to close() or gives up part way with cancel(); every
+// byte must arrive once and in order, and released_bytes() must add up.
+// Rings are reused across rounds through reset().
+//
+// Meant to be run under ThreadSanitizer as well, e.g. configured with
+// -DCMAKE_CXX_FLAGS=-fsanitize=thread. Exits with 1 on the first failure.
+
+#include "audio_ring.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+namespace {
+
+struct Settings {
+    unsigned rounds = 2000;
+    uint32_t seed = 1;
+};
+
+const char* usage = R"(Usage: ring_check [options]
+  --rounds N    producer/consumer rounds (2000)
+  --seed N      random seed (1)
+)";
+
+char pattern(uint64_t offset) {
+    return static_cast<char>(offset * 131 % 251);
+}
+
+struct Round {
+    uint64_t total;
+    // Blocks the consumer takes before cancelling, 0 to drain to the end
+    uint64_t cancel_after;
+    // The consumer yields after about one block in this many, so the ring
+    // runs both full and empty
+    unsigned slow_every;
+};
+
+// Returns an empty string on success, what went wrong otherwise
+std::string run(AudioRing& ring, const Round& round, uint32_t seed) {
+    uint64_t produced = 0;
+    bool released_ok = true;
+    std::thread producer([&] {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<size_t> fill(1, ring.block_size());
+        while (produced < round.total) {
+            auto block = ring.acquire();
+            if (block.empty()) {
+                return;
+            }
+            // Read as the pipe reader does to grant credit
+            released_ok &= ring.released_bytes() <= produced;
+            size_t size = static_cast<size_t>(std::min<uint64_t>(fill(random), round.total - produced));
+            for (size_t i = 0; i < size; i++) {
+                block[i] = pattern(produced + i);
+            }
+            ring.commit(size);
+            produced += size;
+        }
+        ring.close();
+    });
+
+    std::mt19937 random(seed ^ 0x9e3779b9u);
+    std::uniform_int_distribution<unsigned> pause(1, round.slow_every);
+    uint64_t received = 0;
+    uint64_t blocks = 0;
+    bool in_order = true;
+    bool cancelled = false;
+    for (auto block = ring.front(); !block.empty(); block = ring.front()) {
+        for (char c : block) {
+            in_order &= c == pattern(received++);
+        }
+        ring.release();
+        if (++blocks == round.cancel_after) {
+            ring.cancel();
+            cancelled = true;
+            break;
+        }
+        if (pause(random) == 1) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    if (!in_order) {
+        return "bytes out of order";
+    }
+    if (!released_ok) {
+        return "released_bytes ahead of what was committed";
+    }
+    if (ring.released_bytes() != received) {
+        return fmt::format("released_bytes {} after receiving {}", ring.released_bytes(), received);
+    }
+    if (!cancelled && received != round.total) {
+        return fmt::format("{} of {} bytes", received, round.total);
+    }
+    if (cancelled && produced > received + ring.capacity()) {
+        return fmt::format("producer wrote {} bytes past a cancel at {}", produced - received, received);
+    }
+    return "";
+}
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--rounds" && has_value) {
+            settings.rounds = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--seed" && has_value) {
+            settings.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+    return settings;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    std::mt19937 random(settings.seed);
+    std::uniform_int_distribution<unsigned> shape(0, 3);
+    std::uniform_int_distribution<uint64_t> total(0, 64 * 1024);
+    std::uniform_int_distribution<unsigned> cancel(0, 3);
+    std::uniform_int_distribution<unsigned> slow(1, 16);
+
+    // A handful of rings, each reset and reused for many rounds
+    std::vector<std::unique_ptr<AudioRing>> rings;
+    for (size_t blocks = 1; blocks <= 8; blocks *= 2) {
+        rings.push_back(std::make_unique<AudioRing>(blocks, size_t(1) << (blocks + 4)));
+    }
+
+    for (unsigned number = 0; number < settings.rounds; number++) {
+        AudioRing& ring = *rings[shape(random)];
+        ring.reset();
+        Round round {total(random), 0, slow(random)};
+        // One round in four gives up part way
+        if (cancel(random) == 0) {
+            round.cancel_after = 1 + round.total / ring.block_size() / 2;
+        }
+        std::string error = run(ring, round, random());
+        if (!error.empty()) {
+            fmt::print("round {}: {} blocks of {}, {} bytes{}: {}\n", number, ring.capacity() / ring.block_size(),
+                       ring.block_size(), round.total, round.cancel_after ? ", cancelled" : "", error);
+            return 1;
+        }
+    }
+    fmt::print("{} rounds ok\n", settings.rounds);
+    return 0;
+}
@@ -1,62 +1,51 @@
 #pragma once
 
+#include "trace.h"
+
 #include <string>
 #include <string_view>
-
-#ifndef NDEBUG
-
-#include <utility>
-#include <fmt/printf.h>
+#include <fmt/format.h>
 #include <fmt/xchar.h>
 
-#include <windows.h>
+// Ad hoc debug messages, recorded as Debug events of the General trace
+// category. Unlike TRACE they are formatted on the calling thread, but only
+// when debug tracing is enabled; otherwise a call costs the filter check and
+// evaluating the arguments, so keep them out of per-fragment paths. Format
+// strings are checked at compile time, and the calls compile to nothing when
+// PYSAPI_TRACE_MIN_LEVEL leaves out debug events.
 
 namespace {
 
-std::pair<unsigned int, unsigned int> current_time() {
-    static ULONGLONG start_ticks = GetTickCount64();
-    ULONGLONG ticks = GetTickCount64() - start_ticks;
-    unsigned int seconds = ticks / 1000.f;
-    unsigned int millis = ticks - (ULONGLONG)seconds * 1000;
-    return { seconds, millis };
+inline constexpr trace::EventInfo slog_event {"{}", trace::Level::Debug, trace::Category::General, "slog", 0};
+
+inline bool slog_enabled() {
+    return trace::compiled_in(trace::Level::Debug) && trace::enabled(trace::Level::Debug, trace::Category::General);
 }
 
-void slog(const char* message)
+inline void slog(const char* message)
 {
-    std::string s = fmt::format("[tid={}] {}\n", GetCurrentThreadId(), message);
-    OutputDebugStringA(s.c_str());
+    if (slog_enabled()) [[unlikely]]
+    {
+        trace::record(&slog_event, message);
+    }
 }
 
 template <typename... Args>
-void slog(std::string_view format, Args&&... args)
+inline void slog(fmt::format_string<Args...> format, Args&&... args)
 {
-    std::string message = fmt::format("[tid={}] ", GetCurrentThreadId());
-    message += fmt::vformat(fmt::string_view(format), fmt::make_format_args(args...)) + "\n";
-    OutputDebugStringA(message.c_str());
+    if (slog_enabled()) [[unlikely]]
+    {
+        trace::record(&slog_event, fmt::format(format, std::forward<Args>(args)...));
+    }
 }
 
 template <typename... Args>
-void slog(std::wstring_view format, Args&&... args)
+inline void slog(fmt::wformat_string<Args...> format, Args&&... args)
 {
-    std::wstring message = fmt::format(L"[tid={}] ", GetCurrentThreadId());
-    message += vformat(fmt::wstring_view(format), fmt::make_wformat_args(args...)) + L"\n";
-    OutputDebugStringW(message.c_str());
+    if (slog_enabled()) [[unlikely]]
+    {
+        trace::record(&slog_event, fmt::format(format, std::forward<Args>(args)...));
+    }
 }
 
 } // namespace
-
-#else
-
-namespace {
-
-void slog(const char* message) {}
-
-template <typename... Args>
-void slog(std::string_view format, Args&&... args) {}
-
-template <typename... Args>
-void slog(std::wstring_view format, Args&&... args) {}
-
-} // namespace
-
-#endif // NDEBUG
\ No newline at end of file
@@ -0,0 +1,451 @@
+// Soak test for memory growth. Speaks fragments through one of the engine's
+// voice paths for hours, the way a long SAPI session does, and checks that
+// memory stays flat once warmed up:
+//
+//   resident memory   private bytes on Windows, resident set on Linux
+//   heap              live operator new bytes, with allocation accounting
+//                     built in (see allocations.h)
+//   Python blocks     sys.getallocatedblocks(), for leaked objects
+//   voice references  refcount of the Python voice, for leaked Obj copies
+//
+// Samples are taken every --sample-interval seconds. The first one after
+// --warmup is the baseline, and the run fails if the last one has grown
+// past the limits. Per-utterance allocation counts and peaks are reported
+// from the metrics histograms at the end. With --profile, the Python voice
+// is also profiled (see pycpp::profiler).
+
+#include "allocations.h"
+#include "metrics.h"
+#include "native_voice.h"
+#include "pipe_client.h"
+#include "pycpp.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Settings {
+    std::string plugin;
+    std::string plugin_config;
+    std::string python;
+    std::string python_path;
+    std::string pipe;
+    std::string engine;
+    double duration = 60;
+    uint64_t fragments = 0;
+    double warmup = 10;
+    double sample_interval = 10;
+    int64_t max_resident_growth_kb = 4096;
+    int64_t max_heap_growth_kb = 64;
+    int64_t max_python_growth = 1000;
+    std::string csv;
+    std::string profile;
+    unsigned profile_interval_ms = 10;
+};
+
+const char* usage = R"(Usage: soak (--plugin FILE | --python MODULE.CLASS | --pipe NAME) [options]
+  --plugin FILE               native voice plugin to speak through
+  --plugin-config TEXT        configuration string for the plugin
+  --python MODULE.CLASS       Python voice to speak through
+  --python-path DIR           directory to import the voice from
+  --pipe NAME                 pipe server to speak through
+  --engine NAME               engine name sent to the pipe server
+  --duration S                seconds to run (60)
+  --fragments N               stop after N fragments instead
+  --warmup S                  seconds before the baseline sample (10)
+  --sample-interval S         seconds between samples (10)
+  --max-resident-growth-kb N  resident memory growth allowed (4096)
+  --max-heap-growth-kb N      heap growth allowed, with accounting (64)
+  --max-python-growth N       Python block growth allowed (1000)
+  --csv FILE                  write every sample to FILE
+  --profile FILE              write the Python voice's collapsed stacks to FILE
+  --profile-interval MS       milliseconds between profile samples (10)
+)";
+
+const char* fragments_text[] = {
+    "Hello, World!",
+    "The quick brown fox jumps over the lazy dog.",
+    "Please call Stella. Ask her to bring these things with her from the store.",
+    "It is twenty past seven on Tuesday the fourth of March.",
+    "Ça a été très facile, déjà vu. 今日は良い天気ですね。",
+};
+
+struct Sample {
+    double elapsed;
+    uint64_t fragments;
+    int64_t resident_bytes;
+    int64_t heap_bytes;
+    int64_t python_blocks;
+    int64_t voice_refs;
+};
+
+int64_t resident_bytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS_EX counters {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                              sizeof(counters))) {
+        return 0;
+    }
+    return counters.PrivateUsage;
+#else
+    std::ifstream statm("/proc/self/statm");
+    int64_t size = 0;
+    int64_t resident = 0;
+    if (!(statm >> size >> resident)) {
+        return 0;
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// One of the engine's three ways of speaking a fragment
+class Speaker {
+public:
+    virtual ~Speaker() = default;
+
+    // Returns false if the fragment failed
+    virtual bool speak(std::string_view text, metrics::Utterance& utterance) = 0;
+
+    // Python blocks and voice references, -1 when there is no Python voice
+    virtual std::pair<int64_t, int64_t> python_counts() { return {-1, -1}; }
+};
+
+class PluginSpeaker : public Speaker {
+public:
+    PluginSpeaker(const std::string& library, const std::string& config) : voice_(library, config) {}
+
+    bool speak(std::string_view text, metrics::Utterance& utterance) override {
+        try {
+            voice_.speak(text, [&](std::span<const char> data) {
+                utterance.received(data.size());
+                utterance.written(data.size(), 0);
+                return true;
+            });
+            return true;
+        }
+        catch (const std::runtime_error& e) {
+            fmt::print(stderr, "Voice error: {}\n", e.what());
+            return false;
+        }
+    }
+
+private:
+    NativeVoice voice_;
+};
+
+// Mirrors Engine::speak_from_voice, GIL handling included
+class PythonSpeaker : public Speaker {
+public:
+    PythonSpeaker(const std::string& name, const std::string& path) : label_("voice:" + name) {
+        auto dot = name.rfind('.');
+        if (dot == std::string::npos) {
+            throw std::invalid_argument("--python takes MODULE.CLASS");
+        }
+        std::string module_name = name.substr(0, dot);
+        std::string class_name = name.substr(dot + 1);
+
+        pycpp::ScopedGIL lock;
+        if (!path.empty()) {
+            pycpp::PythonVM::add_search_paths({std::filesystem::absolute(path).wstring()});
+        }
+        pycpp::Obj module {PyImport_ImportModule(module_name.c_str())};
+        pycpp::Obj voice_class {PyObject_GetAttrString(module, class_name.c_str())};
+        voice_ = pycpp::call(voice_class);
+    }
+
+    ~PythonSpeaker() override {
+        pycpp::ScopedGIL lock;
+        voice_.reset();
+    }
+
+    bool speak(std::string_view text, metrics::Utterance& utterance) override {
+        static pycpp::Name speak_name {"speak"};
+        pycpp::profiler::Scope profile(label_);
+        try {
+            pycpp::Obj chunks;
+            bool async = false;
+            {
+                pycpp::ScopedGIL lock;
+                pycpp::Obj text_obj {pycpp::convert(text)};
+                pycpp::Obj result = pycpp::call_method(voice_, speak_name, text_obj);
+                async = PyAIter_Check(result);
+                chunks = async ? std::move(result) : pycpp::Obj(PyObject_GetIter(result));
+            }
+
+            auto write_chunks = [&](auto&& range) {
+                for (const auto& chunk : range) {
+                    utterance.received(chunk.data.size());
+                    utterance.written(chunk.data.size(), 0);
+                }
+            };
+            if (async) {
+                write_chunks(pycpp::AsyncIter {std::move(chunks)});
+            } else {
+                write_chunks(pycpp::Iter {std::move(chunks)});
+            }
+            return true;
+        }
+        catch (const pycpp::PythonException& e) {
+            fmt::print(stderr, "Voice error: {}\n", e.what());
+            return false;
+        }
+    }
+
+    std::pair<int64_t, int64_t> python_counts() override {
+        pycpp::ScopedGIL lock;
+        pycpp::Obj blocks {pycpp::call(PySys_GetObject("getallocatedblocks"))};
+        return {PyLong_AsLongLong(blocks), Py_REFCNT(voice_.ptr())};
+    }
+
+private:
+    std::string label_;
+    pycpp::Obj voice_;
+};
+
+class PipeSpeaker : public Speaker {
+public:
+    PipeSpeaker(std::string pipe, std::string engine) : pipe_(std::move(pipe)), engine_(std::move(engine)) {}
+
+    bool speak(std::string_view text, metrics::Utterance& utterance) override {
+        auto result = speak_through_pipe(pipe_, {text, engine_, trace::new_request_id()}, ring_, utterance,
+                                         [&](std::span<const char> block) {
+            utterance.written(block.size(), 0);
+            return true;
+        });
+        return result == PipeSpeakResult::Ok;
+    }
+
+private:
+    std::string pipe_;
+    std::string engine_;
+    AudioRing ring_ {8, 32 * 1024};
+};
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    auto number = [](const char* value) {
+        size_t end = 0;
+        double result = std::stod(value, &end);
+        if (value[end] != '\0' || result < 0) {
+            throw std::invalid_argument(value);
+        }
+        return result;
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--plugin" && has_value) {
+            settings.plugin = argv[++i];
+        } else if (arg == "--plugin-config" && has_value) {
+            settings.plugin_config = argv[++i];
+        } else if (arg == "--python" && has_value) {
+            settings.python = argv[++i];
+        } else if (arg == "--python-path" && has_value) {
+            settings.python_path = argv[++i];
+        } else if (arg == "--pipe" && has_value) {
+            settings.pipe = argv[++i];
+        } else if (arg == "--engine" && has_value) {
+            settings.engine = argv[++i];
+        } else if (arg == "--duration" && has_value) {
+            settings.duration = number(argv[++i]);
+        } else if (arg == "--fragments" && has_value) {
+            settings.fragments = static_cast<uint64_t>(number(argv[++i]));
+        } else if (arg == "--warmup" && has_value) {
+            settings.warmup = number(argv[++i]);
+        } else if (arg == "--sample-interval" && has_value) {
+            settings.sample_interval = number(argv[++i]);
+        } else if (arg == "--max-resident-growth-kb" && has_value) {
+            settings.max_resident_growth_kb = static_cast<int64_t>(number(argv[++i]));
+        } else if (arg == "--max-heap-growth-kb" && has_value) {
+            settings.max_heap_growth_kb = static_cast<int64_t>(number(argv[++i]));
+        } else if (arg == "--max-python-growth" && has_value) {
+            settings.max_python_growth = static_cast<int64_t>(number(argv[++i]));
+        } else if (arg == "--csv" && has_value) {
+            settings.csv = argv[++i];
+        } else if (arg == "--profile" && has_value) {
+            settings.profile = argv[++i];
+        } else if (arg == "--profile-interval" && has_value) {
+            settings.profile_interval_ms = static_cast<unsigned>(number(argv[++i]));
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+
+    int modes = !settings.plugin.empty() + !settings.python.empty() + !settings.pipe.empty();
+    if (modes != 1) {
+        throw std::invalid_argument("exactly one of --plugin, --python and --pipe is needed");
+    }
+    if (settings.sample_interval <= 0) {
+        throw std::invalid_argument("--sample-interval must be positive");
+    }
+    if (!settings.profile.empty() && settings.python.empty()) {
+        throw std::invalid_argument("--profile needs --python");
+    }
+    if (settings.profile_interval_ms == 0) {
+        throw std::invalid_argument("--profile-interval must be positive");
+    }
+    return settings;
+}
+
+std::unique_ptr<Speaker> make_speaker(const Settings& settings) {
+    if (!settings.plugin.empty()) {
+        return std::make_unique<PluginSpeaker>(settings.plugin, settings.plugin_config);
+    }
+    if (!settings.python.empty()) {
+        return std::make_unique<PythonSpeaker>(settings.python, settings.python_path);
+    }
+    return std::make_unique<PipeSpeaker>(settings.pipe, settings.engine);
+}
+
+// Checks one measure of the last sample against the baseline
+bool check_growth(std::string_view name, int64_t baseline, int64_t last, int64_t limit, uint64_t fragments) {
+    if (baseline < 0) {
+        return true;
+    }
+    int64_t growth = last - baseline;
+    double per_million = fragments ? growth * 1e6 / fragments : 0;
+    bool ok = growth <= limit;
+    fmt::print("{:<18} {:>14} -> {:>14}  {:>+12} ({:+.1f} per million fragments, limit {})  {}\n", name, baseline,
+               last, growth, per_million, limit, ok ? "ok" : "GROWING");
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    std::optional<pycpp::PythonVM> vm;
+    std::unique_ptr<Speaker> speaker;
+    try {
+        if (!settings.python.empty()) {
+            vm.emplace();
+            pycpp::profiler::Options profile;
+            profile.file = settings.profile;
+            profile.interval = std::chrono::milliseconds(settings.profile_interval_ms);
+            pycpp::profiler::start(profile);
+        }
+        speaker = make_speaker(settings);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n", e.what());
+        return 2;
+    }
+
+    std::ofstream csv;
+    if (!settings.csv.empty()) {
+        csv.open(settings.csv);
+        csv << "elapsed_s,fragments,resident_bytes,heap_bytes,python_blocks,voice_refs\n";
+    }
+
+    auto& stats = metrics::stats("soak");
+    metrics::Utterance utterance;
+    uint64_t fragments = 0;
+    uint64_t failed = 0;
+    std::optional<Sample> baseline;
+    Sample last {};
+
+    auto take_sample = [&](double elapsed) {
+        auto [python_blocks, voice_refs] = speaker->python_counts();
+        last = {elapsed, fragments, resident_bytes(), allocations::live_bytes(), python_blocks, voice_refs};
+        if (!baseline && elapsed >= settings.warmup) {
+            baseline = last;
+        }
+        fmt::print("{:>8.0f} s {:>12} fragments  resident {:>8} kB  heap {:>8} kB  python blocks {:>8}  "
+                   "voice refs {:>4}\n",
+                   elapsed, fragments, last.resident_bytes / 1024, last.heap_bytes / 1024, python_blocks, voice_refs);
+        std::fflush(stdout);
+        if (csv) {
+            csv << fmt::format("{:.3f},{},{},{},{},{}\n", elapsed, fragments, last.resident_bytes, last.heap_bytes,
+                               python_blocks, voice_refs);
+            csv.flush();
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    auto seconds = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    double next_sample = 0;
+
+    for (;;) {
+        double elapsed = seconds();
+        if (elapsed >= next_sample) {
+            take_sample(elapsed);
+            next_sample += settings.sample_interval;
+        }
+        if (settings.fragments ? fragments >= settings.fragments : elapsed >= settings.duration) {
+            break;
+        }
+
+        std::string_view text = fragments_text[fragments % std::size(fragments_text)];
+        utterance.start();
+        bool ok = speaker->speak(text, utterance);
+        utterance.finish();
+        if (ok) {
+            stats.record(utterance, 0);
+        } else {
+            stats.failed.fetch_add(1, std::memory_order_relaxed);
+            failed++;
+        }
+        fragments++;
+    }
+    if (last.fragments != fragments) {
+        take_sample(seconds());
+    }
+    pycpp::profiler::stop();
+
+    fmt::print("\n{}\n", metrics::report());
+
+    if (!baseline) {
+        fmt::print("The run ended before the warmup, nothing to compare\n");
+        return 1;
+    }
+    uint64_t measured = last.fragments - baseline->fragments;
+    bool ok = true;
+    ok &= check_growth("resident bytes", baseline->resident_bytes, last.resident_bytes,
+                       settings.max_resident_growth_kb * 1024, measured);
+    if constexpr (allocations::enabled) {
+        ok &= check_growth("heap bytes", baseline->heap_bytes, last.heap_bytes, settings.max_heap_growth_kb * 1024,
+                           measured);
+    }
+    ok &= check_growth("python blocks", baseline->python_blocks, last.python_blocks, settings.max_python_growth,
+                       measured);
+    ok &= check_growth("voice refs", baseline->voice_refs, last.voice_refs, 0, measured);
+
+    fmt::print("{} fragments, {} failed: {}\n", fragments, failed, ok && failed == 0 ? "PASS" : "FAIL");
+    return ok && failed == 0 ? 0 : 1;
+}
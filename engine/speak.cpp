@@ -2,7 +2,6 @@
 #include <fmt/xchar.h>
 #include <stdexcept>
 #include <string_view>
-#include <thread>
 #include <memory>
 #include <cassert>
 
@@ -68,7 +67,7 @@ static bool set_voice(CComPtr<ISpVoice>& voice, const wchar_t* voice_name)
     return false;
 }
 
-static void speak(const wchar_t* text, int num_calls) {
+static void speak(const wchar_t* text, const wchar_t* voice_name, int num_calls) {
     HRESULT result = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
     if (result != S_OK) {
         throw std::runtime_error("ConInitializeEx failed");
@@ -86,7 +85,7 @@ static void speak(const wchar_t* text, int num_calls) {
         throw std::runtime_error("GetVoice failed");
     }*/
 
-    if (!set_voice(voice, L"Microsoft David Desktop - English (United States)")) {
+    if (!set_voice(voice, voice_name)) {
         throw std::runtime_error("Voice not found");
     }
 
@@ -110,25 +109,17 @@ static void speak(const wchar_t* text, int num_calls) {
     CoUninitialize();
 }
 
-static void test_threads(const wchar_t* text) {
-    const int num_threads = 10;
-    std::thread threads[num_threads];
-
-    for (int i = 0; i < num_threads; i++) {
-        threads[i] = std::thread(speak, text, 2);
-    }
-
-    for (int i = 0; i < num_threads; i++) {
-        threads[i].join();
-    }
-}
-
+// Speaks one phrase through SAPI, to check a voice end to end. Load tests
+// go through loadgen instead.
 int wmain(int argc, wchar_t* argv[]) {
     const wchar_t* text = L"Hello, World!";
-    if (argc == 2) {
+    const wchar_t* voice_name = L"Microsoft David Desktop - English (United States)";
+    if (argc >= 2) {
         text = argv[1];
     }
+    if (argc >= 3) {
+        voice_name = argv[2];
+    }
 
-    //test_threads(text);
-    speak(text, 1);
+    speak(text, voice_name, 1);
 }
\ No newline at end of file
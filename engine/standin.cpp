@@ -0,0 +1,391 @@
+// Deterministic stand-in for VoiceServer. Speaks the engine's pipe protocol
+// (pipe_client.h) and answers every request with generated PCM on a fixed
+// schedule, so that loadgen and the engine can be benchmarked without a
+// real TTS backend and with the same results from run to run.
+//
+// Per request, timed from when the request line has been read:
+//
+//   first byte    --first-byte-ms after the request
+//   length        --audio-ms of audio, or --ms-per-char times the length
+//                 of the text
+//   pacing        one --chunk-bytes write every --chunk-ms at most
+//   throughput    --max-bytes-per-sec at most
+//   flow control  never more than the client's window past its credit
+//
+// With --error-rate, that fraction of requests is answered badly instead:
+// dropped without audio, truncated, or stalled for --stall-ms part way
+// through. The protocol has no error message, so the client sees what it
+// sees when VoiceServer fails: a short utterance or a long gap. Faults and
+// their positions come from --seed and the connection's number, so the
+// same run injects the same faults.
+
+#include "pipe_client.h"
+#include "pipe_server.h"
+#include "tone_generator.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+namespace {
+
+enum class Fault { None, Drop, Truncate, Stall };
+
+struct Settings {
+    std::string pipe = default_pipe_name;
+    pysapi_voice_format format {24000, 1, 16};
+    ToneGenerator::Wave wave = ToneGenerator::Wave::Sine;
+    double first_byte_ms = 50;
+    double audio_ms = 0;
+    double ms_per_char = 60;
+    size_t chunk_bytes = 4096;
+    double chunk_ms = 0;
+    double max_bytes_per_sec = 0;
+    double error_rate = 0;
+    Fault fault = Fault::Drop;
+    double stall_ms = 500;
+    uint64_t seed = 1;
+    bool verbose = false;
+};
+
+const char* usage = R"(Usage: standin [options]
+  --pipe NAME             pipe name to serve (AACSpeakHelper)
+  --rate HZ               sample rate (24000)
+  --bits N                bits per sample, 8, 16, 24 or 32 (16)
+  --channels N            channels (1)
+  --wave sine|noise|silence
+                          audio content (sine)
+  --first-byte-ms MS      delay before the first byte of audio (50)
+  --audio-ms MS           audio per request; 0 to use --ms-per-char (0)
+  --ms-per-char MS        audio per character of text (60)
+  --chunk-bytes N         bytes per write (4096)
+  --chunk-ms MS           minimum time between writes (0)
+  --max-bytes-per-sec B   throughput cap per request, 0 for none (0)
+  --error-rate P          fraction of requests to answer badly (0)
+  --error drop|truncate|stall
+                          how to answer them (drop)
+  --stall-ms MS           length of a stall (500)
+  --seed N                seed for the fault schedule (1)
+  --verbose               log every request
+)";
+
+uint64_t ms_to_ns(double ms) {
+    return static_cast<uint64_t>(ms * 1e6);
+}
+
+void sleep_until(uint64_t time) {
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(time)));
+}
+
+// Buffers what the client sends: the request line, then credit
+class Input {
+public:
+    explicit Input(PipeConnection& pipe) : pipe_(pipe) {}
+
+    bool read_line(std::string& line) {
+        size_t end;
+        while ((end = buffer_.find('\n')) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 1);
+        return true;
+    }
+
+    // Waits for the next credit message
+    bool read_credit(uint32_t& bytes) {
+        while (buffer_.size() < 4) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        auto byte = [&](size_t i) { return uint32_t(static_cast<unsigned char>(buffer_[i])) << (8 * i); };
+        bytes = byte(0) | byte(1) | byte(2) | byte(3);
+        buffer_.erase(0, 4);
+        return true;
+    }
+
+private:
+    bool fill() {
+        char data[512];
+        ptrdiff_t size = pipe_.read(data);
+        if (size <= 0) {
+            return false;
+        }
+        buffer_.append(data, size);
+        return true;
+    }
+
+    PipeConnection& pipe_;
+    std::string buffer_;
+};
+
+// Value of `key` in a one-line JSON object: the decoded text of a string,
+// the literal otherwise. Enough for the requests send_speak_request()
+// writes, not a general parser.
+std::optional<std::string> json_field(std::string_view json, std::string_view key) {
+    auto pos = json.find(fmt::format("\"{}\":", key));
+    if (pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+    pos += key.size() + 3;
+
+    std::string value;
+    if (pos < json.size() && json[pos] != '"') {
+        auto end = json.find_first_of(",}", pos);
+        return std::string(json.substr(pos, end == std::string_view::npos ? end : end - pos));
+    }
+    for (pos++; pos < json.size() && json[pos] != '"'; pos++) {
+        if (json[pos] == '\\' && pos + 1 < json.size()) {
+            pos++;
+            // Escaped characters only matter for the length of the text
+            if (json[pos] == 'u') {
+                pos += 4;
+                value += '?';
+                continue;
+            }
+        }
+        value += json[pos];
+    }
+    return value;
+}
+
+size_t count_characters(std::string_view utf8) {
+    return std::count_if(utf8.begin(), utf8.end(), [](char c) { return (static_cast<unsigned char>(c) & 0xC0) != 0x80; });
+}
+
+struct Stats {
+    std::atomic<uint64_t> requests {0};
+    std::atomic<uint64_t> faults {0};
+};
+
+void serve(PipeConnection& pipe, const Settings& settings, uint64_t number, Stats& stats) {
+    Input input(pipe);
+    std::string line;
+    if (!input.read_line(line)) {
+        return;
+    }
+    const uint64_t start = trace::Clock::now();
+    stats.requests.fetch_add(1, std::memory_order_relaxed);
+
+    std::string text = json_field(line, "text").value_or("");
+    std::string request_id = json_field(line, "request_id").value_or("");
+    uint64_t window = std::strtoull(json_field(line, "window").value_or("0").c_str(), nullptr, 10);
+
+    ToneGenerator generator(settings.wave, 440.0, 0.25, settings.format);
+    const size_t frame = generator.frame_size();
+    const uint64_t bytes_per_sec = uint64_t(settings.format.samples_per_sec) * frame;
+    double audio_ms = settings.audio_ms > 0 ? settings.audio_ms : settings.ms_per_char * count_characters(text);
+    const uint64_t total = static_cast<uint64_t>(audio_ms * bytes_per_sec / 1000 / frame) * frame;
+
+    // Seeded per connection, so the schedule does not depend on which
+    // thread runs first, and a higher --error-rate keeps the earlier faults
+    std::seed_seq seed {uint32_t(settings.seed), uint32_t(settings.seed >> 32), uint32_t(number)};
+    std::mt19937_64 random(seed);
+    bool faulty = std::uniform_real_distribution<double>()(random) < settings.error_rate;
+    uint64_t fault_at = total > frame ? std::uniform_int_distribution<uint64_t>(0, total / frame - 1)(random) * frame : 0;
+    Fault fault = faulty ? settings.fault : Fault::None;
+    if (fault != Fault::None) {
+        stats.faults.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (settings.verbose) {
+        fmt::print("[{}] #{} request={} {} chars, {} bytes, window {}{}\n", start / 1000000, number, request_id,
+                   count_characters(text), total, window,
+                   fault == Fault::Drop       ? ", drop"
+                   : fault == Fault::Truncate ? fmt::format(", truncate at {}", fault_at)
+                   : fault == Fault::Stall    ? fmt::format(", stall at {}", fault_at)
+                                              : "");
+        std::fflush(stdout);
+    }
+    if (fault == Fault::Drop) {
+        return;
+    }
+
+    // Chunks are whole frames, and never larger than the window
+    size_t chunk_size = std::max(frame, settings.chunk_bytes / frame * frame);
+    if (window != 0) {
+        chunk_size = std::min<uint64_t>(chunk_size, std::max<uint64_t>(frame, window / frame * frame));
+    }
+    std::vector<std::byte> chunk(chunk_size);
+
+    const uint64_t first_byte = start + ms_to_ns(settings.first_byte_ms);
+    uint64_t stall = 0;
+    uint64_t credit = 0;
+    uint64_t sent = 0;
+    for (uint64_t i = 0; sent < total; i++) {
+        uint64_t size = std::min<uint64_t>(chunk_size, total - sent);
+        if (fault == Fault::Truncate && sent + size > fault_at) {
+            size = fault_at - sent;
+            if (size == 0) {
+                break;
+            }
+        }
+        if (fault == Fault::Stall && stall == 0 && sent + size > fault_at) {
+            stall = ms_to_ns(settings.stall_ms);
+        }
+
+        uint64_t due = first_byte + stall + i * ms_to_ns(settings.chunk_ms);
+        if (settings.max_bytes_per_sec > 0) {
+            due = std::max(due, first_byte + stall + static_cast<uint64_t>(sent * 1e9 / settings.max_bytes_per_sec));
+        }
+        sleep_until(due);
+
+        generator.render(std::span(chunk.data(), size));
+
+        // Clients that send a window expect flow control. Whatever credit
+        // there is gets spent, as VoiceServer does: a client may hold back
+        // its grant until it has received everything granted so far.
+        for (uint64_t offset = 0; offset < size;) {
+            uint64_t part = size - offset;
+            if (window != 0) {
+                while (sent == window + credit) {
+                    uint32_t bytes;
+                    if (!input.read_credit(bytes)) {
+                        return;
+                    }
+                    credit += bytes;
+                }
+                part = std::min(part, window + credit - sent);
+            }
+            if (!pipe.write(chunk.data() + offset, part)) {
+                return;
+            }
+            offset += part;
+            sent += part;
+        }
+    }
+    pipe.finish();
+}
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    auto number = [](const char* value) {
+        size_t end = 0;
+        double result = std::stod(value, &end);
+        if (value[end] != '\0' || result < 0) {
+            throw std::invalid_argument(value);
+        }
+        return result;
+    };
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--pipe" && has_value) {
+            settings.pipe = argv[++i];
+        } else if (arg == "--rate" && has_value) {
+            settings.format.samples_per_sec = static_cast<uint32_t>(number(argv[++i]));
+        } else if (arg == "--bits" && has_value) {
+            settings.format.bits_per_sample = static_cast<uint16_t>(number(argv[++i]));
+        } else if (arg == "--channels" && has_value) {
+            settings.format.channels = static_cast<uint16_t>(number(argv[++i]));
+        } else if (arg == "--wave" && has_value) {
+            std::string_view wave = argv[++i];
+            if (wave == "sine") {
+                settings.wave = ToneGenerator::Wave::Sine;
+            } else if (wave == "noise") {
+                settings.wave = ToneGenerator::Wave::Noise;
+            } else if (wave == "silence") {
+                settings.wave = ToneGenerator::Wave::Silence;
+            } else {
+                throw std::invalid_argument(std::string(wave));
+            }
+        } else if (arg == "--first-byte-ms" && has_value) {
+            settings.first_byte_ms = number(argv[++i]);
+        } else if (arg == "--audio-ms" && has_value) {
+            settings.audio_ms = number(argv[++i]);
+        } else if (arg == "--ms-per-char" && has_value) {
+            settings.ms_per_char = number(argv[++i]);
+        } else if (arg == "--chunk-bytes" && has_value) {
+            settings.chunk_bytes = static_cast<size_t>(number(argv[++i]));
+        } else if (arg == "--chunk-ms" && has_value) {
+            settings.chunk_ms = number(argv[++i]);
+        } else if (arg == "--max-bytes-per-sec" && has_value) {
+            settings.max_bytes_per_sec = number(argv[++i]);
+        } else if (arg == "--error-rate" && has_value) {
+            settings.error_rate = number(argv[++i]);
+        } else if (arg == "--error" && has_value) {
+            std::string_view fault = argv[++i];
+            if (fault == "drop") {
+                settings.fault = Fault::Drop;
+            } else if (fault == "truncate") {
+                settings.fault = Fault::Truncate;
+            } else if (fault == "stall") {
+                settings.fault = Fault::Stall;
+            } else {
+                throw std::invalid_argument(std::string(fault));
+            }
+        } else if (arg == "--stall-ms" && has_value) {
+            settings.stall_ms = number(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            settings.seed = static_cast<uint64_t>(number(argv[++i]));
+        } else if (arg == "--verbose") {
+            settings.verbose = true;
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+
+    if (!ToneGenerator::is_valid_format(settings.format)) {
+        throw std::invalid_argument("unsupported audio format");
+    }
+    if (settings.error_rate > 1) {
+        throw std::invalid_argument("--error-rate must be between 0 and 1");
+    }
+    return settings;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    PipeListener listener;
+    if (!listener.listen(settings.pipe)) {
+        fmt::print(stderr, "cannot listen on {}\n", settings.pipe);
+        return 1;
+    }
+    fmt::print("standin serving {}, {} Hz {}-bit {} channel(s)\n", settings.pipe, settings.format.samples_per_sec,
+               settings.format.bits_per_sample, settings.format.channels);
+    std::fflush(stdout);
+
+    // One thread per connection, like VoiceServer
+    Stats stats;
+    for (uint64_t number = 0;; number++) {
+        auto pipe = std::make_unique<PipeConnection>();
+        if (!listener.accept(*pipe)) {
+            fmt::print(stderr, "accept failed after {} requests, {} faults\n", stats.requests.load(),
+                       stats.faults.load());
+            return 1;
+        }
+        std::thread([pipe = std::move(pipe), &settings, number, &stats] {
+            serve(*pipe, settings, number, stats);
+        }).detach();
+    }
+}
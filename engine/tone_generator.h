@@ -0,0 +1,186 @@
+#pragma once
+
+#include "voice_plugin.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// Test signal source for the tone voice and the benchmark tools: a sine
+// tone, white noise or silence in any integer PCM format, generated fast
+// enough that a benchmark measures what it feeds rather than the voice.
+//
+// Samples are computed as floats in blocks, `lanes` at a time. The sine is
+// `lanes` phasors one sample apart, all rotated by `lanes` samples per step,
+// and the noise `lanes` independent xorshift generators. Both are loops over
+// fixed size arrays without branches, which compilers turn into SIMD code.
+class ToneGenerator {
+public:
+    enum class Wave { Sine, Noise, Silence };
+
+    // `volume` is the peak amplitude, 0 to 1. The format must be valid, see
+    // is_valid_format().
+    ToneGenerator(Wave wave, double frequency, double volume, const pysapi_voice_format& format)
+        : wave_(wave), format_(format) {
+        const double pi = 3.14159265358979323846;
+        const double step = 2 * pi * frequency / format.samples_per_sec;
+
+        for (size_t l = 0; l < lanes; l++) {
+            re_[l] = static_cast<float>(std::cos(step * l));
+            im_[l] = static_cast<float>(std::sin(step * l));
+            noise_[l] = 0x9E3779B9u * static_cast<uint32_t>(l + 1);
+        }
+        step_re_ = static_cast<float>(std::cos(step * lanes));
+        step_im_ = static_cast<float>(std::sin(step * lanes));
+
+        // Largest value of the sample type, kept just inside it for 32 bits
+        const double full_scale = format.bits_per_sample == 32 ? 2147483520.0 : std::ldexp(1.0, format.bits_per_sample - 1) - 1;
+        scale_ = static_cast<float>(std::clamp(volume, 0.0, 1.0) * full_scale);
+    }
+
+    static bool is_valid_format(const pysapi_voice_format& format) {
+        return format.samples_per_sec >= 1000 && format.samples_per_sec <= 384000 &&
+               format.channels >= 1 && format.channels <= 8 &&
+               (format.bits_per_sample == 8 || format.bits_per_sample == 16 ||
+                format.bits_per_sample == 24 || format.bits_per_sample == 32);
+    }
+
+    size_t frame_size() const {
+        return size_t(format_.channels) * format_.bits_per_sample / 8;
+    }
+
+    // Fills `out` with whole frames, carrying on from where the last call
+    // stopped. Returns the number of bytes written.
+    size_t render(std::span<std::byte> out) {
+        const size_t frame = frame_size();
+        size_t frames = out.size() / frame;
+        std::byte* dst = out.data();
+
+        while (frames > 0) {
+            if (position_ == block_frames) {
+                next_block();
+                position_ = 0;
+            }
+
+            size_t count = std::min(frames, block_frames - position_);
+            encode(block_ + position_, count, dst);
+            position_ += count;
+            dst += count * frame;
+            frames -= count;
+        }
+
+        return dst - out.data();
+    }
+
+private:
+    static constexpr size_t lanes = 8;
+    static constexpr size_t block_frames = 512;
+
+    void next_block() {
+        switch (wave_) {
+        case Wave::Sine:
+            for (size_t i = 0; i < block_frames; i += lanes) {
+                for (size_t l = 0; l < lanes; l++) {
+                    block_[i + l] = im_[l];
+                    float re = re_[l] * step_re_ - im_[l] * step_im_;
+                    float im = re_[l] * step_im_ + im_[l] * step_re_;
+                    re_[l] = re;
+                    im_[l] = im;
+                }
+            }
+            // Pull the phasors back onto the unit circle before rounding
+            // errors change the amplitude
+            for (size_t l = 0; l < lanes; l++) {
+                float gain = 1.5f - 0.5f * (re_[l] * re_[l] + im_[l] * im_[l]);
+                re_[l] *= gain;
+                im_[l] *= gain;
+            }
+            break;
+
+        case Wave::Noise:
+            for (size_t i = 0; i < block_frames; i += lanes) {
+                for (size_t l = 0; l < lanes; l++) {
+                    uint32_t x = noise_[l];
+                    x ^= x << 13;
+                    x ^= x >> 17;
+                    x ^= x << 5;
+                    noise_[l] = x;
+                    block_[i + l] = static_cast<float>(static_cast<int32_t>(x)) * (1.0f / 2147483648.0f);
+                }
+            }
+            break;
+
+        case Wave::Silence:
+            std::fill(std::begin(block_), std::end(block_), 0.0f);
+            break;
+        }
+    }
+
+    void encode(const float* in, size_t frames, std::byte* out) const {
+        const uint16_t channels = format_.channels;
+
+        switch (format_.bits_per_sample) {
+        case 8:
+            for (size_t i = 0; i < frames; i++) {
+                auto value = static_cast<uint8_t>(128 + static_cast<int32_t>(in[i] * scale_));
+                for (uint16_t c = 0; c < channels; c++) {
+                    *out++ = static_cast<std::byte>(value);
+                }
+            }
+            break;
+
+        case 16:
+            if (channels == 1) {
+                int16_t samples[block_frames];
+                for (size_t i = 0; i < frames; i++) {
+                    samples[i] = static_cast<int16_t>(in[i] * scale_);
+                }
+                std::memcpy(out, samples, frames * sizeof(int16_t));
+                break;
+            }
+            for (size_t i = 0; i < frames; i++) {
+                auto value = static_cast<int16_t>(in[i] * scale_);
+                for (uint16_t c = 0; c < channels; c++, out += 2) {
+                    std::memcpy(out, &value, 2);
+                }
+            }
+            break;
+
+        case 24:
+            for (size_t i = 0; i < frames; i++) {
+                auto value = static_cast<int32_t>(in[i] * scale_);
+                for (uint16_t c = 0; c < channels; c++) {
+                    *out++ = static_cast<std::byte>(value);
+                    *out++ = static_cast<std::byte>(value >> 8);
+                    *out++ = static_cast<std::byte>(value >> 16);
+                }
+            }
+            break;
+
+        case 32:
+            for (size_t i = 0; i < frames; i++) {
+                auto value = static_cast<int32_t>(static_cast<double>(in[i]) * scale_);
+                for (uint16_t c = 0; c < channels; c++, out += 4) {
+                    std::memcpy(out, &value, 4);
+                }
+            }
+            break;
+        }
+    }
+
+    Wave wave_;
+    pysapi_voice_format format_;
+    float scale_;
+
+    alignas(32) float re_[lanes];
+    alignas(32) float im_[lanes];
+    alignas(32) uint32_t noise_[lanes];
+    float step_re_;
+    float step_im_;
+
+    alignas(32) float block_[block_frames];
+    size_t position_ = block_frames;
+};
@@ -0,0 +1,215 @@
+// Reference voice plugin and benchmark source, the native counterpart of
+// voices/dummy.py: every character of the text is spoken as a beep followed
+// by a gap of silence. Audio comes from ToneGenerator, many hundreds of
+// times faster than real time. Has no dependencies, so it also builds on
+// Linux for the benchmark tools.
+//
+// PluginConfig is a ';' separated list of key=value settings:
+//   wave=sine|noise|silence   beep waveform, sine by default
+//   frequency=<Hz>            sine frequency, 400 by default
+//   volume=<0..1>             peak amplitude, 0.5 by default
+//   rate=<Hz>                 sample rate, 24000 by default
+//   channels=<n>              channel count, 1 by default
+//   bits=8|16|24|32           bits per sample, 16 by default
+//   tone_ms=<ms>              beep length, 200 by default
+//   gap_ms=<ms>               silence after each beep, 200 by default
+//   chunk_ms=<ms>             audio per write, 20 by default
+
+#include "tone_generator.h"
+#include "voice_plugin.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+thread_local std::string create_error;
+
+struct Settings {
+    ToneGenerator::Wave wave = ToneGenerator::Wave::Sine;
+    double frequency = 400;
+    double volume = 0.5;
+    pysapi_voice_format format {24000, 1, 16};
+    uint32_t tone_ms = 200;
+    uint32_t gap_ms = 200;
+    uint32_t chunk_ms = 20;
+};
+
+bool parse_number(std::string_view value, double& number) {
+    std::string text(value);
+    char* end = nullptr;
+    number = std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+bool parse_settings(std::string_view config, Settings& settings) {
+    while (!config.empty()) {
+        auto end = config.find(';');
+        auto item = config.substr(0, end);
+        config = end == std::string_view::npos ? std::string_view {} : config.substr(end + 1);
+        if (item.empty()) {
+            continue;
+        }
+
+        auto eq = item.find('=');
+        auto key = item.substr(0, eq);
+        auto value = eq == std::string_view::npos ? std::string_view {} : item.substr(eq + 1);
+
+        if (key == "wave") {
+            if (value == "sine") {
+                settings.wave = ToneGenerator::Wave::Sine;
+            } else if (value == "noise") {
+                settings.wave = ToneGenerator::Wave::Noise;
+            } else if (value == "silence") {
+                settings.wave = ToneGenerator::Wave::Silence;
+            } else {
+                create_error = "unknown wave: " + std::string(value);
+                return false;
+            }
+            continue;
+        }
+
+        double number = 0;
+        if (!parse_number(value, number) || number < 0) {
+            create_error = "invalid setting: " + std::string(item);
+            return false;
+        }
+
+        if (key == "frequency") {
+            settings.frequency = number;
+        } else if (key == "volume") {
+            settings.volume = number;
+        } else if (key == "rate") {
+            settings.format.samples_per_sec = static_cast<uint32_t>(number);
+        } else if (key == "channels") {
+            settings.format.channels = static_cast<uint16_t>(number);
+        } else if (key == "bits") {
+            settings.format.bits_per_sample = static_cast<uint16_t>(number);
+        } else if (key == "tone_ms") {
+            settings.tone_ms = static_cast<uint32_t>(number);
+        } else if (key == "gap_ms") {
+            settings.gap_ms = static_cast<uint32_t>(number);
+        } else if (key == "chunk_ms") {
+            settings.chunk_ms = static_cast<uint32_t>(number);
+        } else {
+            create_error = "unknown setting: " + std::string(item);
+            return false;
+        }
+    }
+
+    if (!ToneGenerator::is_valid_format(settings.format)) {
+        create_error = "unsupported format";
+        return false;
+    }
+    if (settings.frequency <= 0 || settings.frequency >= settings.format.samples_per_sec / 2.0) {
+        create_error = "frequency out of range";
+        return false;
+    }
+    if (settings.volume > 1 || settings.chunk_ms == 0) {
+        create_error = "volume or chunk_ms out of range";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+struct pysapi_voice {
+    pysapi_voice(const Settings& settings)
+        : settings(settings),
+          tone(settings.wave, settings.frequency, settings.volume, settings.format),
+          silence(ToneGenerator::Wave::Silence, settings.frequency, 0, settings.format) {}
+
+    Settings settings;
+    ToneGenerator tone;
+    ToneGenerator silence;
+    std::vector<std::byte> buffer;
+    std::string error;
+};
+
+namespace {
+
+size_t bytes_for(const pysapi_voice& voice, uint32_t ms) {
+    const auto& format = voice.settings.format;
+    return size_t(format.samples_per_sec) * ms / 1000 * voice.tone.frame_size();
+}
+
+pysapi_voice* create(const char* config) {
+    Settings settings;
+    if (!parse_settings(config, settings)) {
+        return nullptr;
+    }
+
+    auto* voice = new (std::nothrow) pysapi_voice(settings);
+    if (voice == nullptr) {
+        create_error = "out of memory";
+        return nullptr;
+    }
+
+    voice->buffer.resize(std::max(bytes_for(*voice, settings.chunk_ms), voice->tone.frame_size()));
+    return voice;
+}
+
+void destroy(pysapi_voice* voice) {
+    delete voice;
+}
+
+void format(const pysapi_voice* voice, pysapi_voice_format* format) {
+    *format = voice->settings.format;
+}
+
+// Writes `bytes` of audio from `generator` in chunks. Returns false if the
+// host asked to stop.
+bool write_audio(pysapi_voice* voice, ToneGenerator& generator, size_t bytes, pysapi_voice_write write, void* context) {
+    while (bytes > 0) {
+        size_t size = std::min(bytes, voice->buffer.size());
+        size = generator.render(std::span(voice->buffer.data(), size));
+        if (size == 0 || write(context, voice->buffer.data(), size) != 0) {
+            return false;
+        }
+        bytes -= size;
+    }
+    return true;
+}
+
+int speak(pysapi_voice* voice, const char* text, size_t length, pysapi_voice_write write, void* context) {
+    const size_t tone_bytes = bytes_for(*voice, voice->settings.tone_ms);
+    const size_t gap_bytes = bytes_for(*voice, voice->settings.gap_ms);
+
+    for (size_t i = 0; i < length; i++) {
+        // One beep per character, not per UTF-8 byte
+        if ((static_cast<unsigned char>(text[i]) & 0xC0) == 0x80) {
+            continue;
+        }
+
+        if (!write_audio(voice, voice->tone, tone_bytes, write, context) ||
+            !write_audio(voice, voice->silence, gap_bytes, write, context)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+const char* error(const pysapi_voice* voice) {
+    return voice ? voice->error.c_str() : create_error.c_str();
+}
+
+constexpr pysapi_voice_plugin plugin = {
+    PYSAPI_VOICE_ABI_VERSION,
+    sizeof(pysapi_voice_plugin),
+    create,
+    destroy,
+    format,
+    speak,
+    error,
+};
+
+} // namespace
+
+extern "C" PYSAPI_VOICE_EXPORT const pysapi_voice_plugin* pysapi_get_voice_plugin() {
+    return &plugin;
+}
@@ -0,0 +1,575 @@
+#include "trace.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <fmt/args.h>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace trace;
+
+std::atomic<uint64_t> trace::detail::filter {0};
+
+namespace {
+
+// Per thread, a power of 2. The largest event is a quarter of it.
+constexpr size_t ring_capacity = 256 * 1024;
+
+enum class RecordKind : uint32_t { Event, Padding };
+
+// Records start 8-byte aligned, so at least the size and kind of a padding
+// record always fit before the end of the ring
+struct RecordHeader {
+    // Without the alignment
+    uint32_t size;
+    RecordKind kind;
+    uint64_t timestamp;
+    const EventInfo* info;
+};
+
+size_t align8(size_t size) {
+    return (size + 7) & ~size_t(7);
+}
+
+uint32_t current_thread_id() {
+#if defined(_WIN32)
+    return GetCurrentThreadId();
+#else
+    return static_cast<uint32_t>(syscall(SYS_gettid));
+#endif
+}
+
+uint32_t current_process_id() {
+#if defined(_WIN32)
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+// Written by its thread, read by the flusher
+struct ThreadRing {
+    std::unique_ptr<std::byte[]> data {new std::byte[ring_capacity]};
+    const uint32_t thread_id = current_thread_id();
+
+    alignas(64) std::atomic<uint64_t> head {0};
+    uint64_t cached_tail = 0;
+    uint64_t event_end = 0;
+    bool wake_flusher = false;
+
+    alignas(64) std::atomic<uint64_t> tail {0};
+    std::atomic<bool> exited {false};
+};
+
+struct Event {
+    uint64_t timestamp;
+    uint32_t thread_id;
+    const EventInfo* info;
+    std::string message;
+    // Spans only
+    uint64_t start = 0;
+    uint64_t request_id = 0;
+};
+
+struct State {
+    const uint64_t start_time = Clock::now();
+
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+
+    // Guards everything below, and serializes flushes
+    std::mutex flush_mutex;
+    Options options;
+    FILE* file = nullptr;
+    uint64_t file_size = 0;
+    FILE* chrome_file = nullptr;
+    uint64_t dropped_reported = 0;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<bool> flusher_started {false};
+    std::atomic<int64_t> flush_interval_ms {100};
+    std::atomic<uint64_t> dropped {0};
+};
+
+// Never destroyed: threads may still trace while the process exits
+State& state() {
+    static State* instance = new State;
+    return *instance;
+}
+
+struct RingOwner {
+    std::shared_ptr<ThreadRing> ring;
+
+    ~RingOwner() {
+        if (ring) {
+            ring->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local RingOwner ring_owner;
+
+ThreadRing* thread_ring() noexcept {
+    auto& ring = ring_owner.ring;
+    if (!ring) {
+        try {
+            auto new_ring = std::make_shared<ThreadRing>();
+            std::lock_guard lock(state().rings_mutex);
+            state().rings.push_back(new_ring);
+            ring = std::move(new_ring);
+        }
+        catch (...) {
+            return nullptr;
+        }
+    }
+    return ring.get();
+}
+
+void append_utf8(std::string& out, const std::byte* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        wchar_t unit;
+        std::memcpy(&unit, data + i * sizeof(wchar_t), sizeof(wchar_t));
+        uint32_t c = static_cast<uint32_t>(unit);
+
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length) {
+                wchar_t low;
+                std::memcpy(&low, data + (i + 1) * sizeof(wchar_t), sizeof(wchar_t));
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    i++;
+                }
+            }
+        }
+        if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF) {
+            c = 0xFFFD;
+        }
+
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+}
+
+std::string format_event(const EventInfo* info, const std::byte* args, const std::byte* end) {
+    using detail::ArgType;
+
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    while (args < end) {
+        auto type = static_cast<ArgType>(*args++);
+        if (type == ArgType::String || type == ArgType::WString) {
+            uint32_t length;
+            std::memcpy(&length, args, sizeof(length));
+            args += sizeof(length);
+            if (type == ArgType::String) {
+                store.push_back(std::string(reinterpret_cast<const char*>(args), length));
+                args += length;
+            } else {
+                std::string text;
+                append_utf8(text, args, length);
+                store.push_back(std::move(text));
+                args += length * sizeof(wchar_t);
+            }
+            continue;
+        }
+
+        uint64_t bits;
+        std::memcpy(&bits, args, sizeof(bits));
+        args += sizeof(bits);
+
+        switch (type) {
+        case ArgType::Int:
+            store.push_back(static_cast<int64_t>(bits));
+            break;
+        case ArgType::UInt:
+            store.push_back(bits);
+            break;
+        case ArgType::Double: {
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            store.push_back(value);
+            break;
+        }
+        case ArgType::Bool:
+            store.push_back(bits != 0);
+            break;
+        case ArgType::Pointer:
+            store.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(bits)));
+            break;
+        default:
+            break;
+        }
+    }
+
+    try {
+        return fmt::vformat(info->format, store);
+    }
+    catch (const fmt::format_error& e) {
+        return fmt::format("{} [format error: {}]", info->format, e.what());
+    }
+}
+
+// Formats the committed events of `ring` into `events` and frees their space
+void drain(ThreadRing& ring, std::vector<Event>& events) {
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    const uint64_t head = ring.head.load(std::memory_order_acquire);
+
+    while (tail < head) {
+        const std::byte* record = ring.data.get() + (tail & (ring_capacity - 1));
+        RecordHeader header;
+        std::memcpy(&header, record, sizeof(uint32_t) * 2);
+
+        if (header.kind == RecordKind::Event) {
+            std::memcpy(&header, record, sizeof(header));
+            if (header.info->span) {
+                // Two UInt arguments, each a type byte and 8 bytes
+                const std::byte* args = record + sizeof(header);
+                uint64_t start, request_id;
+                std::memcpy(&start, args + 1, sizeof(start));
+                std::memcpy(&request_id, args + 10, sizeof(request_id));
+                events.push_back({header.timestamp, ring.thread_id, header.info,
+                                  fmt::format("{} {}us request={:016x}", header.info->format,
+                                              (header.timestamp - start) / 1000, request_id),
+                                  start, request_id});
+            } else {
+                events.push_back({header.timestamp, ring.thread_id, header.info,
+                                  format_event(header.info, record + sizeof(header), record + header.size)});
+            }
+        }
+        tail += align8(header.size);
+    }
+
+    ring.tail.store(tail, std::memory_order_release);
+}
+
+void open_file(State& s, const char* mode) {
+#if defined(_WIN32)
+    s.file = _wfopen(s.options.file.c_str(), mode[0] == 'a' ? L"ab" : L"wb");
+#else
+    s.file = std::fopen(s.options.file.c_str(), mode);
+#endif
+    s.file_size = 0;
+    if (s.file == nullptr) {
+        return;
+    }
+
+    std::fseek(s.file, 0, SEEK_END);
+    s.file_size = std::ftell(s.file);
+
+    // Ties the monotonic event times to wall clock time, to line up traces
+    // of other processes
+    auto since_start = std::chrono::nanoseconds(Clock::now() - s.start_time);
+    auto start = std::chrono::system_clock::now() - since_start;
+    auto header = fmt::format("# trace time 0 is unix time {:.6f}, pid {}\n",
+                              std::chrono::duration<double>(start.time_since_epoch()).count(), current_process_id());
+    std::fwrite(header.data(), 1, header.size(), s.file);
+    s.file_size += header.size();
+}
+
+void rotate(State& s) {
+    std::fclose(s.file);
+    s.file = nullptr;
+
+    const auto& path = s.options.file;
+    auto numbered = [&](unsigned n) {
+        auto name = path;
+        name += ".";
+        name += std::to_string(n);
+        return name;
+    };
+
+    std::error_code error;
+    if (s.options.max_files > 0) {
+        std::filesystem::remove(numbered(s.options.max_files), error);
+        for (unsigned n = s.options.max_files; n > 1; n--) {
+            std::filesystem::rename(numbered(n - 1), numbered(n), error);
+        }
+        std::filesystem::rename(path, numbered(1), error);
+    }
+
+    open_file(s, "wb");
+}
+
+void append_json_string(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned>(c));
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+void open_chrome_file(State& s) {
+#if defined(_WIN32)
+    s.chrome_file = _wfopen(s.options.chrome_file.c_str(), L"ab");
+#else
+    s.chrome_file = std::fopen(s.options.chrome_file.c_str(), "ab");
+#endif
+    if (s.chrome_file == nullptr) {
+        return;
+    }
+
+    std::fseek(s.chrome_file, 0, SEEK_END);
+    std::string header = std::ftell(s.chrome_file) == 0 ? "[\n" : "";
+    fmt::format_to(std::back_inserter(header),
+                   "{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},\"args\":{{\"name\":\"pysapittsengine\"}}}},\n",
+                   current_process_id());
+    std::fwrite(header.data(), 1, header.size(), s.chrome_file);
+}
+
+void write_chrome_event(State& s, const Event& event) {
+    const auto& info = *event.info;
+    std::string line = "{\"name\":";
+    if (info.span) {
+        append_json_string(line, info.format);
+        fmt::format_to(std::back_inserter(line), ",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f}",
+                       to_string(info.category), event.start / 1e3, (event.timestamp - event.start) / 1e3);
+    } else {
+        append_json_string(line, event.message);
+        fmt::format_to(std::back_inserter(line), ",\"cat\":\"{}\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f}",
+                       to_string(info.category), event.timestamp / 1e3);
+    }
+    fmt::format_to(std::back_inserter(line), ",\"pid\":{},\"tid\":{}", current_process_id(), event.thread_id);
+    if (event.request_id != 0) {
+        fmt::format_to(std::back_inserter(line), ",\"args\":{{\"request_id\":\"{:016x}\"}}", event.request_id);
+    }
+    line += "},\n";
+    std::fwrite(line.data(), 1, line.size(), s.chrome_file);
+}
+
+void write_line(State& s, const std::string& line) {
+    if (s.options.debug_output) {
+#if defined(_WIN32)
+        OutputDebugStringA(line.c_str());
+#else
+        std::fputs(line.c_str(), stderr);
+#endif
+    }
+
+    if (s.file == nullptr) {
+        return;
+    }
+
+    std::fwrite(line.data(), 1, line.size(), s.file);
+    s.file_size += line.size();
+    if (s.file_size >= s.options.max_file_size) {
+        rotate(s);
+    }
+}
+
+void flusher_main() {
+    auto& s = state();
+    for (;;) {
+        {
+            std::unique_lock lock(s.wake_mutex);
+            s.wake.wait_for(lock, std::chrono::milliseconds(s.flush_interval_ms.load(std::memory_order_relaxed)));
+        }
+        flush();
+    }
+}
+
+} // namespace
+
+const char* trace::to_string(Level level) {
+    static const char* names[] = {"D", "I", "W", "E"};
+    return level < Level::Count ? names[unsigned(level)] : "?";
+}
+
+const char* trace::to_string(Category category) {
+    static const char* names[] = {"general", "engine", "python", "pipe", "voice", "audio"};
+    return category < Category::Count ? names[unsigned(category)] : "?";
+}
+
+std::byte* trace::detail::begin_event(const EventInfo* info, size_t size) noexcept {
+    ThreadRing* ring = thread_ring();
+    const size_t total = align8(sizeof(RecordHeader) + size);
+    if (ring == nullptr || total > ring_capacity / 4) {
+        state().dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    size_t offset = head & (ring_capacity - 1);
+    const size_t contiguous = ring_capacity - offset;
+    const size_t needed = total <= contiguous ? total : contiguous + total;
+
+    if (head + needed - ring->cached_tail > ring_capacity) {
+        ring->cached_tail = ring->tail.load(std::memory_order_acquire);
+        if (head + needed - ring->cached_tail > ring_capacity) {
+            state().dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+    }
+
+    // Events are never split, the rest of the ring is skipped instead
+    if (total > contiguous) {
+        RecordHeader padding {static_cast<uint32_t>(contiguous), RecordKind::Padding, 0, nullptr};
+        std::memcpy(ring->data.get() + offset, &padding, sizeof(uint32_t) * 2);
+        head += contiguous;
+        offset = 0;
+    }
+
+    RecordHeader header {static_cast<uint32_t>(sizeof(RecordHeader) + size), RecordKind::Event, Clock::now(), info};
+    std::memcpy(ring->data.get() + offset, &header, sizeof(header));
+
+    ring->event_end = head + total;
+    ring->wake_flusher = info->level >= Level::Error;
+    return ring->data.get() + offset + sizeof(header);
+}
+
+void trace::detail::commit_event() noexcept {
+    ThreadRing* ring = ring_owner.ring.get();
+    ring->head.store(ring->event_end, std::memory_order_release);
+
+    if (ring->wake_flusher) {
+        state().wake.notify_one();
+    }
+}
+
+void trace::start(const Options& options) {
+    auto& s = state();
+    {
+        std::lock_guard lock(s.flush_mutex);
+        if (s.file != nullptr) {
+            std::fclose(s.file);
+            s.file = nullptr;
+        }
+
+        if (s.chrome_file != nullptr) {
+            std::fclose(s.chrome_file);
+            s.chrome_file = nullptr;
+        }
+
+        s.options = options;
+        if (!options.file.empty()) {
+            open_file(s, "ab");
+        }
+        if (!options.chrome_file.empty()) {
+            open_chrome_file(s);
+        }
+        s.flush_interval_ms.store(options.flush_interval.count(), std::memory_order_relaxed);
+    }
+
+    set_filter(options.level, options.categories);
+
+    if (!s.flusher_started.exchange(true)) {
+        std::thread(flusher_main).detach();
+    }
+}
+
+void trace::set_filter(Level level, uint16_t categories) {
+    uint64_t filter = 0;
+    for (unsigned l = unsigned(level); l < unsigned(Level::Count); l++) {
+        filter |= uint64_t(categories) << (l * 16);
+    }
+    detail::filter.store(filter, std::memory_order_relaxed);
+}
+
+void trace::flush() {
+    auto& s = state();
+    std::lock_guard lock(s.flush_mutex);
+
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard rings_lock(s.rings_mutex);
+        rings = s.rings;
+    }
+
+    std::vector<Event> events;
+    for (const auto& ring : rings) {
+        // Read `exited` first: once set, the thread has committed its last event
+        bool exited = ring->exited.load(std::memory_order_acquire);
+        drain(*ring, events);
+        if (exited) {
+            std::lock_guard rings_lock(s.rings_mutex);
+            std::erase(s.rings, ring);
+        }
+    }
+
+    // Each ring is in order, merge them into one timeline
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event& a, const Event& b) { return a.timestamp < b.timestamp; });
+
+    for (const auto& event : events) {
+        double seconds = (event.timestamp - s.start_time) / 1e9;
+        const auto& info = *event.info;
+
+        std::string line;
+        if (info.level >= Level::Warning) {
+            std::string_view file = info.file;
+            file = file.substr(file.find_last_of("/\\") + 1);
+            line = fmt::format("{:.6f} [tid={}] {} {}: {} ({}:{})\n", seconds, event.thread_id, to_string(info.level),
+                               to_string(info.category), event.message, file, info.line);
+        } else {
+            line = fmt::format("{:.6f} [tid={}] {} {}: {}\n", seconds, event.thread_id, to_string(info.level),
+                               to_string(info.category), event.message);
+        }
+        write_line(s, line);
+
+        if (s.chrome_file != nullptr) {
+            write_chrome_event(s, event);
+        }
+    }
+
+    uint64_t dropped = s.dropped.load(std::memory_order_relaxed);
+    if (dropped != s.dropped_reported) {
+        write_line(s, fmt::format("{:.6f} {} events dropped\n", (Clock::now() - s.start_time) / 1e9,
+                                  dropped - s.dropped_reported));
+        s.dropped_reported = dropped;
+    }
+
+    if (s.file != nullptr) {
+        std::fflush(s.file);
+    }
+    if (s.chrome_file != nullptr) {
+        std::fflush(s.chrome_file);
+    }
+}
+
+uint64_t trace::dropped() {
+    return state().dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t trace::new_request_id() noexcept {
+    static std::atomic<uint32_t> counter {0};
+    return uint64_t(current_process_id()) << 32 | (counter.fetch_add(1, std::memory_order_relaxed) + 1);
+}
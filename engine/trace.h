@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <fmt/format.h>
+
+// Always available structured tracing, in release builds too.
+//
+// TRACE records a binary event: a timestamp, a pointer to the static
+// description of the call site and the raw arguments, appended to a
+// lock-free ring owned by the calling thread. A background thread drains
+// the rings, formats the events and writes them to a rotating log file, so
+// the traced thread never formats, allocates, locks or does I/O. Events
+// that do not fit in the ring are dropped and counted, never waited for.
+//
+// Events are filtered at runtime by level and category. A filtered out
+// event costs one relaxed load and one well predicted branch, and its
+// arguments are not evaluated. Events below PYSAPI_TRACE_MIN_LEVEL are not
+// compiled in at all. Format strings are checked against the arguments at
+// compile time.
+//
+//     TRACE(trace::Level::Info, trace::Category::Pipe, "connected in {}us", elapsed_us);
+//
+// TRACE_SAMPLED records only one in n of the events of its call site that
+// pass the filter, for messages on per-chunk paths.
+//
+// TRACE_SPAN times the rest of the enclosing scope, tagged with the id of
+// the request it works on. Besides the log, events and spans can be written
+// to a Chrome trace file, to be viewed in Perfetto or chrome://tracing next
+// to the spans VoiceServer records for the same request ids.
+//
+//     TRACE_SPAN(trace::Level::Info, trace::Category::Pipe, "pipe.connect", request_id);
+
+// Lowest level compiled in, as a number: 0 debug, 1 info, 2 warning, 3 error
+#ifndef PYSAPI_TRACE_MIN_LEVEL
+#define PYSAPI_TRACE_MIN_LEVEL 0
+#endif
+
+namespace trace {
+
+enum class Level : uint8_t { Debug, Info, Warning, Error, Count };
+
+constexpr bool compiled_in(Level level) {
+    // As a signed difference: comparing the level itself against a floor of
+    // 0 is always true and trips -Wtype-limits
+    return int(level) - PYSAPI_TRACE_MIN_LEVEL >= 0;
+}
+
+// At most 16 categories, one bit each in the filter
+enum class Category : uint8_t { General, Engine, Python, Pipe, Voice, Audio, Count };
+
+const char* to_string(Level level);
+const char* to_string(Category category);
+
+// Monotonic event clock, in nanoseconds from an arbitrary start. Backed by
+// steady_clock: QueryPerformanceCounter on Windows, CLOCK_MONOTONIC on Linux.
+struct Clock {
+    static uint64_t now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+// Static description of a call site. `format` is formatted with fmt by the
+// flusher thread.
+struct EventInfo {
+    const char* format;
+    Level level;
+    Category category;
+    const char* file;
+    uint32_t line;
+    // Recorded by Span: `format` is the span name, and the arguments are
+    // its start time and request id
+    bool span = false;
+};
+
+struct Options {
+    // Log file, rotated to file.1, file.2, ... once it reaches max_file_size.
+    // No file is written when empty.
+    std::filesystem::path file;
+    uint64_t max_file_size = 16 * 1024 * 1024;
+    unsigned max_files = 3;
+
+    // Events below `level`, or outside the `categories` bit mask, are
+    // discarded at the call site
+    Level level = Level::Warning;
+    uint16_t categories = 0xFFFF;
+
+    // Also send each line to the debugger (OutputDebugString), or stderr
+    // where there is none
+    bool debug_output = false;
+
+    // How often the flusher drains the rings; errors are flushed at once
+    std::chrono::milliseconds flush_interval {100};
+
+    // Chrome trace event file, appended to in the JSON array format without
+    // the closing bracket. Spans are complete events and the others instant
+    // events, timestamped in microseconds of Clock. Not rotated. Nothing is
+    // written when empty.
+    std::filesystem::path chrome_file;
+};
+
+// Sets the filter and the outputs, and starts the flusher thread if
+// needed. May be called again to reconfigure.
+void start(const Options& options);
+
+// Sets only the filter
+void set_filter(Level level, uint16_t categories);
+
+// Drains every ring and writes the events out before returning
+void flush();
+
+// Events dropped so far because a ring was full
+uint64_t dropped();
+
+// Returns a new id for a request, unique across processes on this machine
+uint64_t new_request_id() noexcept;
+
+namespace detail {
+
+extern std::atomic<uint64_t> filter;
+
+constexpr uint64_t filter_bit(Level level, Category category) {
+    return uint64_t(1) << (unsigned(level) * 16 + unsigned(category));
+}
+
+enum class ArgType : uint8_t { Int, UInt, Double, Bool, Pointer, String, WString };
+
+// Longest string argument kept, in code units; longer ones are truncated
+inline constexpr size_t max_string = 4096;
+
+// Reserves `size` bytes of argument payload for an event in the calling
+// thread's ring. Returns nullptr, and counts a drop, if the ring is full.
+std::byte* begin_event(const EventInfo* info, size_t size) noexcept;
+void commit_event() noexcept;
+
+template <typename T>
+constexpr bool is_string_v = std::is_convertible_v<const T&, std::string_view>;
+
+template <typename T>
+constexpr bool is_wstring_v = std::is_convertible_v<const T&, std::wstring_view>;
+
+template <typename T>
+size_t encoded_size(const T& value) {
+    if constexpr (is_string_v<T>) {
+        return 1 + sizeof(uint32_t) + std::min(std::string_view(value).size(), max_string);
+    } else if constexpr (is_wstring_v<T>) {
+        return 1 + sizeof(uint32_t) + std::min(std::wstring_view(value).size(), max_string) * sizeof(wchar_t);
+    } else {
+        return 1 + sizeof(uint64_t);
+    }
+}
+
+template <typename T>
+void encode(std::byte*& out, const T& value) {
+    auto put = [&](ArgType type, const void* data, size_t size) {
+        *out++ = static_cast<std::byte>(type);
+        std::memcpy(out, data, size);
+        out += size;
+    };
+    auto put_string = [&](ArgType type, const void* data, size_t length, size_t unit) {
+        auto count = static_cast<uint32_t>(std::min(length, max_string));
+        put(type, &count, sizeof(count));
+        std::memcpy(out, data, count * unit);
+        out += count * unit;
+    };
+
+    if constexpr (is_string_v<T>) {
+        std::string_view s(value);
+        put_string(ArgType::String, s.data(), s.size(), 1);
+    } else if constexpr (is_wstring_v<T>) {
+        std::wstring_view s(value);
+        put_string(ArgType::WString, s.data(), s.size(), sizeof(wchar_t));
+    } else if constexpr (std::is_same_v<T, bool>) {
+        uint64_t v = value;
+        put(ArgType::Bool, &v, sizeof(v));
+    } else if constexpr (std::is_enum_v<T>) {
+        int64_t v = static_cast<int64_t>(value);
+        put(ArgType::Int, &v, sizeof(v));
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        int64_t v = value;
+        put(ArgType::Int, &v, sizeof(v));
+    } else if constexpr (std::is_integral_v<T>) {
+        uint64_t v = value;
+        put(ArgType::UInt, &v, sizeof(v));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        double v = value;
+        put(ArgType::Double, &v, sizeof(v));
+    } else if constexpr (std::is_pointer_v<T>) {
+        uint64_t v = reinterpret_cast<uintptr_t>(value);
+        put(ArgType::Pointer, &v, sizeof(v));
+    } else {
+        static_assert(std::is_pointer_v<T>, "unsupported trace argument type");
+    }
+}
+
+// Type the flusher formats an argument of type T as
+template <typename T>
+auto decoded_type() {
+    if constexpr (is_string_v<T> || is_wstring_v<T>) {
+        return std::type_identity<std::string> {};
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return std::type_identity<bool> {};
+    } else if constexpr (std::is_enum_v<T> || (std::is_integral_v<T> && std::is_signed_v<T>)) {
+        return std::type_identity<int64_t> {};
+    } else if constexpr (std::is_integral_v<T>) {
+        return std::type_identity<uint64_t> {};
+    } else if constexpr (std::is_floating_point_v<T>) {
+        return std::type_identity<double> {};
+    } else {
+        return std::type_identity<const void*> {};
+    }
+}
+
+template <typename T>
+using decoded_t = typename decltype(decoded_type<std::remove_cvref_t<T>>())::type;
+
+// Checked at compile time against the decoded arguments
+template <typename... Args>
+using format_string = fmt::format_string<decoded_t<Args>...>;
+
+// True for one in `n` calls
+inline bool sample(std::atomic<uint32_t>& count, uint32_t n) noexcept {
+    return count.fetch_add(1, std::memory_order_relaxed) % n == 0;
+}
+
+} // namespace detail
+
+inline bool enabled(Level level, Category category) noexcept {
+    return (detail::filter.load(std::memory_order_relaxed) & detail::filter_bit(level, category)) != 0;
+}
+
+// Records an event without checking the filter; use TRACE
+template <typename... Args>
+void record(const EventInfo* info, const Args&... args) noexcept {
+    size_t size = (detail::encoded_size(args) + ... + 0);
+    std::byte* out = detail::begin_event(info, size);
+    if (out == nullptr) {
+        return;
+    }
+    (detail::encode(out, args), ...);
+    detail::commit_event();
+}
+
+namespace detail {
+
+// record() with the format string checked; used by TRACE
+template <typename... Args>
+void record_checked(const EventInfo* info, format_string<Args...>, const Args&... args) noexcept {
+    record(info, args...);
+}
+
+} // namespace detail
+
+// Records its lifetime as a span, if the span's level and category are
+// enabled when it starts; use TRACE_SPAN
+class Span {
+public:
+    Span(const EventInfo* info, uint64_t request_id) noexcept
+        : info_(enabled(info->level, info->category) ? info : nullptr),
+          request_id_(request_id),
+          start_(info_ ? Clock::now() : 0) {}
+
+    ~Span() {
+        if (info_ != nullptr) {
+            record(info_, start_, request_id_);
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const EventInfo* info_;
+    uint64_t request_id_;
+    uint64_t start_;
+};
+
+// Stands in for Span when its level is not compiled in
+struct NoSpan {
+    constexpr NoSpan(const EventInfo*, uint64_t) noexcept {}
+};
+
+} // namespace trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SPAN(level, category, name, request_id)                                                     \
+    static constexpr ::trace::EventInfo TRACE_CONCAT(trace_span_info_, __LINE__) {                       \
+        name, level, category, __FILE__, __LINE__, true};                                                 \
+    std::conditional_t<::trace::compiled_in(level), ::trace::Span, ::trace::NoSpan>                     \
+        TRACE_CONCAT(trace_span_, __LINE__) {&TRACE_CONCAT(trace_span_info_, __LINE__), request_id}
+
+#define TRACE(level, category, format, ...)                                                             \
+    do {                                                                                                \
+        if constexpr (::trace::compiled_in(level)) {                                                    \
+            static constexpr ::trace::EventInfo trace_event_ {format, level, category, __FILE__, __LINE__}; \
+            if (::trace::enabled(level, category)) [[unlikely]] {                                       \
+                ::trace::detail::record_checked(&trace_event_, format __VA_OPT__(,) __VA_ARGS__);       \
+            }                                                                                           \
+        }                                                                                               \
+    } while (0)
+
+#define TRACE_SAMPLED(n, level, category, format, ...)                                                  \
+    do {                                                                                                \
+        if constexpr (::trace::compiled_in(level)) {                                                    \
+            static constexpr ::trace::EventInfo trace_event_ {format, level, category, __FILE__, __LINE__}; \
+            static std::atomic<uint32_t> trace_count_ {0};                                              \
+            if (::trace::enabled(level, category) && ::trace::detail::sample(trace_count_, n)) [[unlikely]] { \
+                ::trace::detail::record_checked(&trace_event_, format __VA_OPT__(,) __VA_ARGS__);       \
+            }                                                                                           \
+        }                                                                                               \
+    } while (0)
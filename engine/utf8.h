@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Transcodes UTF-16 to UTF-8 into `out`, reusing its storage so a buffer kept
+// across fragments stops allocating once it has grown to the largest one.
+// Works on any 16-bit code unit type: wchar_t on Windows, char16_t elsewhere.
+//
+// Runs of ASCII are handled eight code units at a time with 64-bit word
+// tests, which every compiler turns into plain loads and stores. Surrogate
+// pairs become 4-byte sequences; unpaired surrogates are replaced with
+// U+FFFD, as WideCharToMultiByte does. Returns the number of replacements.
+template <typename CharT>
+size_t utf8_encode(std::basic_string_view<CharT> in, std::string& out)
+{
+    static_assert(sizeof(CharT) == 2, "utf8_encode expects UTF-16 code units");
+
+    // Every code unit takes at most 3 bytes; a surrogate pair takes 4 for 2.
+    // Only grow, so shrinking afterwards keeps the capacity and the next call
+    // does not zero-fill memory it is about to overwrite.
+    const size_t max_size = in.size() * 3;
+    if (out.size() < max_size) {
+        out.resize(max_size);
+    }
+
+    const CharT* src = in.data();
+    const CharT* const end = src + in.size();
+    char* dst = out.data();
+    size_t replaced = 0;
+
+    while (src < end) {
+        while (end - src >= 8) {
+            uint64_t words[2];
+            std::memcpy(words, src, sizeof(words));
+            if ((words[0] | words[1]) & 0xFF80FF80FF80FF80ull) {
+                break;
+            }
+            for (int i = 0; i < 8; i++) {
+                dst[i] = static_cast<char>(src[i]);
+            }
+            src += 8;
+            dst += 8;
+        }
+
+        if (src == end) {
+            break;
+        }
+
+        uint32_t c = static_cast<uint16_t>(*src++);
+
+        if (c < 0x80) {
+            *dst++ = static_cast<char>(c);
+            continue;
+        }
+
+        if (c < 0x800) {
+            *dst++ = static_cast<char>(0xC0 | (c >> 6));
+            *dst++ = static_cast<char>(0x80 | (c & 0x3F));
+            continue;
+        }
+
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            uint32_t low = src < end ? static_cast<uint16_t>(*src) : 0;
+            if (c <= 0xDBFF && low >= 0xDC00 && low <= 0xDFFF) {
+                src++;
+                uint32_t code_point = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                *dst++ = static_cast<char>(0xF0 | (code_point >> 18));
+                *dst++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+                *dst++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+                *dst++ = static_cast<char>(0x80 | (code_point & 0x3F));
+                continue;
+            }
+
+            c = 0xFFFD;
+            replaced++;
+        }
+
+        *dst++ = static_cast<char>(0xE0 | (c >> 12));
+        *dst++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        *dst++ = static_cast<char>(0x80 | (c & 0x3F));
+    }
+
+    out.resize(dst - out.data());
+    return replaced;
+}
+
+template <typename CharT>
+std::string utf8_encode(std::basic_string_view<CharT> in)
+{
+    std::string out;
+    utf8_encode(in, out);
+    return out;
+}
@@ -0,0 +1,217 @@
+// Checks utf8_encode on surrogate pairs, lone and reversed surrogates and
+// the boundaries of its eight-unit ASCII runs. Valid UTF-16 must decode
+// back to the same code units. Each unpaired surrogate must become one
+// U+FFFD and be counted. Random text must match a plain per-code-point
+// encoder, and on Windows WideCharToMultiByte as well.
+//
+// Exits with 1 on the first mismatch.
+
+#include "utf8.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <fmt/format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace {
+
+struct Settings {
+    unsigned rounds = 20000;
+    uint32_t seed = 1;
+};
+
+const char* usage = R"(Usage: utf8_check [options]
+  --rounds N    random texts (20000)
+  --seed N      random seed (1)
+)";
+
+// UTF-8 back to UTF-16, for text utf8_encode produced. Returns false on a
+// malformed sequence.
+bool utf8_decode(std::string_view in, std::u16string& out) {
+    out.clear();
+    for (size_t i = 0; i < in.size();) {
+        auto byte = [&](size_t k) { return static_cast<uint32_t>(static_cast<unsigned char>(in[i + k])); };
+        uint32_t lead = byte(0);
+        size_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+        if (i + length > in.size() || (lead >= 0x80 && lead < 0xC2) || lead > 0xF4) {
+            return false;
+        }
+        uint32_t c = length == 1 ? lead : lead & (0x7F >> length);
+        for (size_t k = 1; k < length; k++) {
+            if ((byte(k) & 0xC0) != 0x80) {
+                return false;
+            }
+            c = (c << 6) | (byte(k) & 0x3F);
+        }
+        const uint32_t min[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (c < min[length] || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+            return false;
+        }
+        if (c >= 0x10000) {
+            out += static_cast<char16_t>(0xD800 + ((c - 0x10000) >> 10));
+            out += static_cast<char16_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+        } else {
+            out += static_cast<char16_t>(c);
+        }
+        i += length;
+    }
+    return true;
+}
+
+// One code point at a time, with no fast path
+std::string reference_encode(std::u16string_view in, size_t& replaced) {
+    std::string out;
+    replaced = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        uint32_t c = in[i];
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < in.size() && in[i + 1] >= 0xDC00 && in[i + 1] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (in[++i] - 0xDC00);
+        } else if (c >= 0xD800 && c <= 0xDFFF) {
+            c = 0xFFFD;
+            replaced++;
+        }
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+std::string hex(std::u16string_view text) {
+    std::string out;
+    for (char16_t c : text) {
+        out += fmt::format("{}{:04X}", out.empty() ? "" : " ", static_cast<unsigned>(c));
+    }
+    return out;
+}
+
+// Returns an empty string on success, what went wrong otherwise
+std::string check(std::u16string_view text) {
+    std::string out = "stale contents to be overwritten";
+    size_t replaced = utf8_encode(text, out);
+
+    size_t expected_replaced;
+    std::string expected = reference_encode(text, expected_replaced);
+    if (out != expected) {
+        return "differs from the reference encoder";
+    }
+    if (replaced != expected_replaced) {
+        return fmt::format("{} replacements counted, {} expected", replaced, expected_replaced);
+    }
+
+    std::u16string decoded;
+    if (!utf8_decode(out, decoded)) {
+        return "malformed UTF-8";
+    }
+    if (replaced == 0 && decoded != text) {
+        return "does not round-trip";
+    }
+
+#if defined(_WIN32)
+    std::wstring wide(text.begin(), text.end());
+    int size = WideCharToMultiByte(CP_UTF8, 0, wide.data(), (int)wide.size(), nullptr, 0, nullptr, nullptr);
+    std::string windows(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, wide.data(), (int)wide.size(), windows.data(), size, nullptr, nullptr);
+    if (out != windows) {
+        return "differs from WideCharToMultiByte";
+    }
+#endif
+    return "";
+}
+
+Settings parse_args(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i < argc - 1;
+        if (arg == "--rounds" && has_value) {
+            settings.rounds = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--seed" && has_value) {
+            settings.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--help") {
+            fmt::print("{}", usage);
+            std::exit(0);
+        } else {
+            throw std::invalid_argument(std::string(arg));
+        }
+    }
+    return settings;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    try {
+        settings = parse_args(argc, argv);
+    }
+    catch (const std::exception& e) {
+        fmt::print(stderr, "{}\n{}", e.what(), usage);
+        return 2;
+    }
+
+    const std::u16string_view fixed[] = {
+        u"",
+        u"plain ascii, longer than one eight-unit run",
+        u"\U0001F600",
+        u"abcdefg\U0001F600abcdefgh",
+        u"\U00010000\U0010FFFF",
+        u"\xD800",
+        u"\xDC00",
+        u"abc\xDC00\xD800xyz",
+        u"trailing high \xDBFF",
+        u"\xD83D\xD83D\xDE00",
+        u"\xD83D" u"abcdefgh",
+        u"\x7F\x80\x7FF\x800\xFFFF\xFFFD",
+    };
+    for (auto text : fixed) {
+        std::string error = check(text);
+        if (!error.empty()) {
+            fmt::print("[{}]: {}\n", hex(text), error);
+            return 1;
+        }
+    }
+
+    // Mostly ASCII so the word-at-a-time runs start and stop at every
+    // offset, with the other ranges and surrogates mixed in
+    std::mt19937 random(settings.seed);
+    std::uniform_int_distribution<size_t> length(0, 40);
+    std::uniform_int_distribution<unsigned> kind(0, 9);
+    std::uniform_int_distribution<unsigned> unit(0, 0xFFFF);
+    std::uniform_int_distribution<unsigned> surrogate(0xD800, 0xDFFF);
+    for (unsigned round = 0; round < settings.rounds; round++) {
+        std::u16string text(length(random), u'\0');
+        for (auto& c : text) {
+            unsigned k = kind(random);
+            c = static_cast<char16_t>(k < 6 ? unit(random) & 0x7F : k < 8 ? unit(random) : surrogate(random));
+        }
+        std::string error = check(text);
+        if (!error.empty()) {
+            fmt::print("[{}]: {}\n", hex(text), error);
+            return 1;
+        }
+    }
+    fmt::print("{} fixed and {} random texts ok\n", std::size(fixed), settings.rounds);
+    return 0;
+}
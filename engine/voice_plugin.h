@@ -0,0 +1,75 @@
+#pragma once
+
+// Stable C ABI for native voice plugins, for engines with their own C/C++
+// inference libraries that would gain nothing from going through Python.
+//
+// A plugin is a shared library exporting pysapi_get_voice_plugin(). A voice
+// token selects it with the Plugin value, the path of the library, and may
+// pass it settings with the PluginConfig value.
+//
+// Only plain C crosses the boundary: no C++ types, no exceptions, and memory
+// is always freed by the side that allocated it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PYSAPI_VOICE_ABI_VERSION 1
+
+#if defined(_WIN32)
+#define PYSAPI_VOICE_EXPORT __declspec(dllexport)
+#else
+#define PYSAPI_VOICE_EXPORT __attribute__((visibility("default")))
+#endif
+
+typedef struct pysapi_voice pysapi_voice;
+
+// Interleaved little-endian integer PCM
+typedef struct pysapi_voice_format {
+    uint32_t samples_per_sec;
+    uint16_t channels;
+    uint16_t bits_per_sample;
+} pysapi_voice_format;
+
+// Receives each block of audio, in the format of the voice. Returns 0 to
+// continue, or nonzero to stop the utterance, as when SAPI aborts it.
+typedef int (*pysapi_voice_write)(void* context, const void* data, size_t size);
+
+typedef struct pysapi_voice_plugin {
+    // PYSAPI_VOICE_ABI_VERSION and sizeof(pysapi_voice_plugin) as the plugin
+    // was built, so later versions can append fields. The engine loads any
+    // version from 1 on that is at least as large as its own struct.
+    uint32_t abi_version;
+    uint32_t size;
+
+    // Creates a voice from the UTF-8 PluginConfig value, "" when it is not
+    // set. Returns NULL on failure.
+    pysapi_voice* (*create)(const char* config);
+    void (*destroy)(pysapi_voice* voice);
+
+    // Format of all audio the voice writes, fixed for its lifetime. Rates
+    // and channels must be nonzero and samples 8, 16, 24 or 32 bits, or the
+    // plugin fails to load.
+    void (*format)(const pysapi_voice* voice, pysapi_voice_format* format);
+
+    // Synthesizes `length` bytes of UTF-8 text, streaming the audio through
+    // `write` before returning. Returns 0 on success, including when `write`
+    // stopped it, and nonzero on failure. A voice is never used by two
+    // threads at once, but may be used by different threads in turn.
+    int (*speak)(pysapi_voice* voice, const char* text, size_t length, pysapi_voice_write write, void* context);
+
+    // Describes the last failure of `voice`, or of create() on this thread
+    // when `voice` is NULL. Valid until the next call on the same voice.
+    const char* (*error)(const pysapi_voice* voice);
+} pysapi_voice_plugin;
+
+// Name and type of the function every plugin exports
+#define PYSAPI_VOICE_PLUGIN_ENTRY "pysapi_get_voice_plugin"
+typedef const pysapi_voice_plugin* (*pysapi_voice_plugin_entry)(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,168 @@
+#include "voice_registry.h"
+#include "live_stats.h"
+#include "slog.h"
+
+#include <thread>
+
+VoiceRegistry::Lease::Lease(Lease&& other) noexcept : entry_(std::move(other.entry_)) {}
+
+VoiceRegistry::Lease& VoiceRegistry::Lease::operator=(Lease&& other) {
+    if (this != &other) {
+        reset();
+        entry_ = std::move(other.entry_);
+    }
+    return *this;
+}
+
+VoiceRegistry::Lease::~Lease() {
+    reset();
+}
+
+const pycpp::Obj& VoiceRegistry::Lease::wait() const {
+    assert(entry_);
+
+    auto state = entry_->state.load(std::memory_order_acquire);
+    if (state == Loading) {
+        live_stats::Gauge waiting(&pysapi_stats::waiting_for_voice);
+        auto start = Clock::now();
+        entry_->state.wait(Loading, std::memory_order_acquire);
+        state = entry_->state.load(std::memory_order_acquire);
+        slog(L"VoiceRegistry: waited {}ms for {}",
+             std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count(),
+             entry_->token_id);
+    }
+
+    if (state == Failed) {
+        throw pycpp::PythonException(std::string(entry_->error));
+    }
+    return entry_->voice;
+}
+
+bool VoiceRegistry::Lease::ready() const {
+    assert(entry_);
+    return entry_->state.load(std::memory_order_acquire) != Loading;
+}
+
+const pycpp::Obj& VoiceRegistry::Lease::voice() const {
+    assert(entry_ && entry_->state.load(std::memory_order_acquire) == Ready);
+    return entry_->voice;
+}
+
+VoiceRegistry::Clock::duration VoiceRegistry::Lease::load_time() const {
+    assert(entry_);
+    return entry_->state.load(std::memory_order_acquire) == Ready ? entry_->load_time : Clock::duration {};
+}
+
+void VoiceRegistry::Lease::reset() {
+    if (entry_) {
+        VoiceRegistry::instance().release(entry_);
+        entry_.reset();
+    }
+}
+
+VoiceRegistry& VoiceRegistry::instance() {
+    // Never destroyed: the voices can only be released with the GIL, and
+    // the interpreter is never finalized
+    static VoiceRegistry* registry = new VoiceRegistry;
+    return *registry;
+}
+
+VoiceRegistry::Lease VoiceRegistry::acquire(const std::wstring& token_id, const std::wstring& source,
+                                            std::function<pycpp::Obj()> create) {
+    auto now = Clock::now();
+    evict_idle(now);
+
+    auto& slot = entries_[token_id];
+    if (slot && slot->source == source && slot->state.load(std::memory_order_acquire) != Failed) {
+        slog(L"VoiceRegistry: attached to {}, leases={}", token_id, slot->leases + 1);
+        slot->leases++;
+        live_stats::add(&pysapi_stats::voice_cache_hits);
+        return Lease(slot);
+    }
+    live_stats::add(&pysapi_stats::voice_cache_misses);
+
+    // A replaced entry lives on until its last lease ends
+    auto entry = std::make_shared<Entry>();
+    entry->token_id = token_id;
+    entry->source = source;
+    entry->leases = 1;
+    slot = entry;
+
+    load(entry, std::move(create));
+    return Lease(entry);
+}
+
+void VoiceRegistry::load(const std::shared_ptr<Entry>& entry, std::function<pycpp::Obj()> create) {
+    // Counted from here, the thread may wait a while for the GIL
+    live_stats::add(&pysapi_stats::voices_loading);
+    std::thread([this, entry = entry, create = std::move(create)]() mutable {
+        pycpp::ScopedGIL lock;
+        construct(*entry, create);
+        live_stats::sub(&pysapi_stats::voices_loading);
+
+        // Either may hold the last reference to a Python object, so they go
+        // while the GIL is still held
+        entry.reset();
+        create = nullptr;
+    }).detach();
+}
+
+void VoiceRegistry::construct(Entry& entry, const std::function<pycpp::Obj()>& create) {
+    auto fail = [&](std::string error) {
+        entry.error = std::move(error);
+        entry.state.store(Failed, std::memory_order_release);
+        entry.state.notify_all();
+
+        // Let the next acquire() try again
+        auto it = entries_.find(entry.token_id);
+        if (it != entries_.end() && it->second.get() == &entry) {
+            entries_.erase(it);
+        }
+    };
+
+    if (entry.leases == 0) {
+        slog(L"VoiceRegistry: {} unused, not loaded", entry.token_id);
+        fail("voice released before it was loaded");
+        return;
+    }
+
+    auto start = Clock::now();
+    try {
+        entry.voice = create();
+    }
+    catch (const std::exception& e) {
+        slog(L"VoiceRegistry: loading {} failed", entry.token_id);
+        fail(e.what());
+        return;
+    }
+    entry.load_time = Clock::now() - start;
+
+    slog(L"VoiceRegistry: loaded {} in {}ms, voices={}", entry.token_id,
+         std::chrono::duration_cast<std::chrono::milliseconds>(entry.load_time).count(), entries_.size());
+
+    entry.state.store(Ready, std::memory_order_release);
+    entry.state.notify_all();
+}
+
+void VoiceRegistry::release(const std::shared_ptr<Entry>& entry) {
+    assert(entry->leases > 0);
+
+    auto now = Clock::now();
+    if (--entry->leases == 0) {
+        entry->idle_since = now;
+    }
+    evict_idle(now);
+}
+
+void VoiceRegistry::evict_idle(Clock::time_point now) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        const auto& entry = *it->second;
+        if (entry.leases == 0 && now - entry.idle_since >= idle_timeout_ &&
+            entry.state.load(std::memory_order_acquire) != Loading) {
+            slog(L"VoiceRegistry: evicted {}", entry.token_id);
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
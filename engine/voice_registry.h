@@ -0,0 +1,110 @@
+#pragma once
+
+#include "pycpp.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Process-wide cache of constructed voice objects, keyed by token id. A new
+// Engine for a voice that is already loaded attaches to the existing object
+// instead of importing the module and constructing the voice again, which
+// for cloud voices also means reusing their credentials and connections.
+//
+// Voices are constructed on a background thread, so setting a token does not
+// block the client thread on imports and network setup. Lease::wait() blocks
+// only while the voice is still loading. A load is skipped if every lease on
+// it has ended before it got to run.
+//
+// Entries are reference counted by Lease. Once nobody holds an entry it is
+// kept for idle_timeout in case the voice is selected again, and dropped by
+// the next acquire() or release after that.
+//
+// The registry is guarded by the GIL: acquire() and everything that ends a
+// Lease require it. Lease::wait() must be called without it, the loader
+// thread needs it.
+class VoiceRegistry {
+    struct Entry;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Shared reference to a registered voice
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other);
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        // Blocks until the voice has loaded. Throws PythonException if
+        // loading failed. Must be called without the GIL.
+        const pycpp::Obj& wait() const;
+
+        // Whether wait() would return without blocking
+        bool ready() const;
+
+        // Loaded voice, only valid once wait() has returned
+        const pycpp::Obj& voice() const;
+
+        // Time the voice took to construct, zero until it has loaded
+        Clock::duration load_time() const;
+
+        explicit operator bool() const { return entry_ != nullptr; }
+
+        void reset();
+
+    private:
+        friend class VoiceRegistry;
+        explicit Lease(std::shared_ptr<Entry> entry) : entry_(std::move(entry)) {}
+
+        std::shared_ptr<Entry> entry_;
+    };
+
+    static VoiceRegistry& instance();
+
+    // Returns the voice registered for `token_id`, without waiting for it to
+    // load. It is constructed with `create` on a background thread when
+    // there is none yet, when its load failed, or when the registered one
+    // was built from a different `source` (module, class and path of the
+    // token), as happens when a voice is registered again with new settings.
+    Lease acquire(const std::wstring& token_id, const std::wstring& source,
+                  std::function<pycpp::Obj()> create);
+
+    void set_idle_timeout(Clock::duration timeout) { idle_timeout_ = timeout; }
+
+    // Number of voices held, in use or idle
+    size_t size() const { return entries_.size(); }
+
+private:
+    enum State : uint32_t { Loading, Ready, Failed };
+
+    struct Entry {
+        std::wstring token_id;
+        std::wstring source;
+        size_t leases = 0;
+        Clock::time_point idle_since;
+
+        // Written by the loader before `state` is released
+        std::atomic<uint32_t> state {Loading};
+        pycpp::Obj voice;
+        std::string error;
+        Clock::duration load_time {};
+    };
+
+    VoiceRegistry() = default;
+
+    void load(const std::shared_ptr<Entry>& entry, std::function<pycpp::Obj()> create);
+    void construct(Entry& entry, const std::function<pycpp::Obj()>& create);
+    void release(const std::shared_ptr<Entry>& entry);
+    void evict_idle(Clock::time_point now);
+
+    std::unordered_map<std::wstring, std::shared_ptr<Entry>> entries_;
+    Clock::duration idle_timeout_ = std::chrono::minutes(5);
+};
@@ -0,0 +1,54 @@
+"""Compares two result files of the engine's bench tool.
+
+Each benchmark is compared on its fastest repetition, the figure least
+disturbed by other work on the machine. Exits with status 1 if any
+benchmark got slower by more than the threshold, so it can gate a build.
+
+    bench --json > base.json        (on the base commit)
+    bench --json > new.json         (on the change)
+    python tools/compare_bench.py base.json new.json --threshold 10
+"""
+
+import argparse
+import json
+import sys
+
+
+def read_results(path):
+    with open(path, encoding="utf-8") as f:
+        return {result["name"]: result for result in json.load(f)["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("base", help="results of the base commit")
+    parser.add_argument("new", help="results to compare with them")
+    parser.add_argument("--threshold", type=float, default=10,
+                        help="percentage slowdown counted as a regression (10)")
+    args = parser.parse_args()
+
+    base = read_results(args.base)
+    new = read_results(args.new)
+
+    regressions = 0
+    print(f"{'benchmark':<28} {'base ns':>12} {'new ns':>12} {'change':>8}")
+    for name in sorted(base.keys() | new.keys()):
+        if name not in base or name not in new:
+            print(f"{name:<28} {'only in ' + ('base' if name in base else 'new'):>34}")
+            continue
+        before = base[name]["min_ns"]
+        after = new[name]["min_ns"]
+        change = (after - before) / before * 100 if before else 0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<28} {before:>12.1f} {after:>12.1f} {change:>+7.1f}%{flag}")
+
+    if regressions:
+        print(f"\n{regressions} benchmark(s) slower by more than {args.threshold}%")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+"""Merges Chrome trace files of the engine and VoiceServer into one.
+
+Both write the JSON array format without the closing bracket, one event per
+line, timestamped with the same monotonic clock. The merged file links the
+spans of each request id with flow arrows, so a request can be followed
+from Engine::Speak through VoiceServer and back.
+
+    python tools/merge_traces.py engine.json voice-server.json -o merged.json
+
+Open the result in https://ui.perfetto.dev or chrome://tracing.
+"""
+
+import argparse
+import json
+from collections import defaultdict
+
+
+def read_events(path):
+    events = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.strip().rstrip(",")
+            if line in ("", "[", "]"):
+                continue
+            try:
+                events.append(json.loads(line))
+            except json.JSONDecodeError:
+                # A line cut short by a crash
+                pass
+    return events
+
+
+def add_flows(events):
+    """Chains the spans of each request, in time order, with flow events."""
+    spans = defaultdict(list)
+    for event in events:
+        request_id = event.get("args", {}).get("request_id")
+        if event.get("ph") == "X" and request_id:
+            spans[request_id].append(event)
+
+    flows = []
+    for flow_id, (request_id, chain) in enumerate(sorted(spans.items()), 1):
+        chain.sort(key=lambda event: event["ts"])
+        for i, span in enumerate(chain):
+            phase = "s" if i == 0 else "f" if i == len(chain) - 1 else "t"
+            flow = {
+                "name": "request",
+                "cat": "request",
+                "ph": phase,
+                "id": flow_id,
+                "ts": span["ts"],
+                "pid": span["pid"],
+                "tid": span["tid"],
+                "args": {"request_id": request_id},
+            }
+            if phase != "s":
+                flow["bp"] = "e"
+            flows.append(flow)
+    return flows
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("traces", nargs="+", help="Chrome trace files to merge")
+    parser.add_argument("-o", "--output", required=True, help="merged trace file")
+    args = parser.parse_args()
+
+    events = []
+    for path in args.traces:
+        events += read_events(path)
+    events += add_flows(events)
+    events.sort(key=lambda event: event.get("ts", 0))
+
+    with open(args.output, "w", encoding="utf-8") as f:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, f)
+
+
+if __name__ == "__main__":
+    main()
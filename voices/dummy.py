@@ -13,14 +13,22 @@ class Voice(ABC):
         pass
 
 
+# Matches the format the engine advertises (SPSF_24kHz16BitMono)
+SAMPLING_RATE = 24000
+
+
 class DummyVoice(Voice):
     def __init__(self):
         super().__init__()
 
+        # Rendered once, so speak() costs next to nothing
+        self.beep = generate_sine_wave(SAMPLING_RATE, 0.5, 0.2, 400)
+        self.silence = bytes(len(self.beep))
+
     def speak(self, text: str) -> Generator[bytes, None, None]:
         for _ in text:
-            yield generate_sine_wave(16000, 0.5, 0.2, 400)
-            yield bytes(int(16000 * 0.2))
+            yield self.beep
+            yield self.silence
 
 
 def generate_sine_wave(